@@ -0,0 +1,473 @@
+// Замеры производительности SearchServer на данных из generators.h.
+// Сборка из каталога search-server:
+//   g++ -std=c++17 -O2 -I. benchmark/benchmark.cpp $(ls *.cpp | grep -v main.cpp) -o search_server_benchmark -ltbb -lpthread
+// Параметры, списки через запятую:
+//   --documents=10000     размеры корпуса
+//   --stop-words=1,300    число стоп-слов, берутся первые слова словаря
+//   --query-words=3,70    слов в запросе
+//   --minus-prob=0,0.2    вероятность минус-слова
+//   --threads=1,N         потоков для параллельных версий, N — число ядер
+//   --queries=100         запросов в одном замере
+//   --repetitions=1       повторов замера, в результат идёт самый быстрый
+//   --filter=find_top     только замеры с такой подстрокой в имени
+//   --output=result.json  куда записать результат, по умолчанию stdout
+//   --compare=base.json   сравнить с сохранённым результатом
+//   --threshold=0.1       рост ns/op, который считается регрессией
+// Результат — JSON с одним замером на строку. При сравнении замеры сопоставляются по ключу,
+// при регрессии код выхода 1
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tbb/global_control.h>
+
+#include "command_line.h"
+#include "concurrent_map.h"
+#include "generators.h"
+#include "memory_status.h"
+#include "process_queries.h"
+#include "search_server.h"
+#include "string_processing.h"
+
+using namespace std;
+
+namespace {
+
+std::atomic<uint64_t> allocation_count = 0;
+std::atomic<uint64_t> allocated_bytes = 0;
+
+} // namespace
+
+// Счётчик выделений памяти на всё время работы программы. Освобождение не встраивается:
+// иначе GCC принимает free после встроенного new за несовпадение new и delete
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+
+constexpr int DICTIONARY_SIZE = 1000;
+constexpr int MAX_WORD_LENGTH = 10;
+constexpr int DOCUMENT_WORD_COUNT = 70;
+// Сколько документов проверяет MatchDocument на каждый запрос
+constexpr int MATCHED_DOCUMENTS_PER_QUERY = 10;
+constexpr size_t CONCURRENT_MAP_INCREMENTS = 1'000'000;
+
+struct Options {
+    vector<int> document_counts = {10'000};
+    vector<int> stop_word_counts = {1};
+    vector<int> query_word_counts = {3, 70};
+    vector<double> minus_probs = {0, 0.2};
+    vector<size_t> thread_counts;
+    int query_count = 100;
+    int repetitions = 1;
+    string filter;
+    string output_path;
+    string compare_path;
+    double threshold = 0.1;
+};
+
+// Параметры замера, -1 — параметр к замеру не относится
+struct Params {
+    int documents = -1;
+    int query_words = -1;
+    double minus_prob = -1;
+    int threads = -1;
+    // Указывается, только если стоп-слов не одно, чтобы ключи прежних результатов не менялись
+    int stop_words = -1;
+};
+
+struct Measurement {
+    string name;
+    Params params;
+    uint64_t ops = 0;
+    double seconds = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    size_t peak_rss_kb = 0;
+
+    string GetKey() const {
+        ostringstream key;
+        key << name;
+        if (params.documents >= 0) {
+            key << "/documents="s << params.documents;
+        }
+        if (params.query_words >= 0) {
+            key << "/query_words="s << params.query_words;
+        }
+        if (params.minus_prob >= 0) {
+            key << "/minus_prob="s << params.minus_prob;
+        }
+        if (params.threads >= 0) {
+            key << "/threads="s << params.threads;
+        }
+        if (params.stop_words >= 0) {
+            key << "/stop_words="s << params.stop_words;
+        }
+        return key.str();
+    }
+
+    double GetNsPerOp() const {
+        return ops == 0 ? 0 : seconds * 1e9 / ops;
+    }
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    // На одноядерной машине остаётся один вариант
+    options.thread_counts = {1};
+    if (thread::hardware_concurrency() > 1) {
+        options.thread_counts.push_back(thread::hardware_concurrency());
+    }
+    const auto parse_int = [](const string& text) {
+        return stoi(text);
+    };
+    for (const auto& [name, value] : ParseArguments(argc, argv)) {
+        if (name == "documents"s) {
+            options.document_counts = ParseList(value, parse_int);
+        } else if (name == "stop-words"s) {
+            options.stop_word_counts = ParseList(value, parse_int);
+        } else if (name == "query-words"s) {
+            options.query_word_counts = ParseList(value, parse_int);
+        } else if (name == "minus-prob"s) {
+            options.minus_probs = ParseList(value, [](const string& text) {
+                return stod(text);
+            });
+        } else if (name == "threads"s) {
+            options.thread_counts = ParseList(value, [](const string& text) {
+                return static_cast<size_t>(max(1, stoi(text)));
+            });
+        } else if (name == "queries"s) {
+            options.query_count = max(1, stoi(value));
+        } else if (name == "repetitions"s) {
+            options.repetitions = max(1, stoi(value));
+        } else if (name == "filter"s) {
+            options.filter = value;
+        } else if (name == "output"s) {
+            options.output_path = value;
+        } else if (name == "compare"s) {
+            options.compare_path = value;
+        } else if (name == "threshold"s) {
+            options.threshold = stod(value);
+        } else {
+            throw invalid_argument("Unknown argument: --"s + name);
+        }
+    }
+    return options;
+}
+
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const Options& options)
+        : options_(options) {
+    }
+
+    bool IsEnabled(const string& name) const {
+        return name.find(options_.filter) != string::npos;
+    }
+
+    // prepare() вызывается перед каждым повтором вне замера, run() замеряется
+    template <typename Prepare, typename Run>
+    void Measure(const string& name, const Params& params, uint64_t ops, Prepare prepare, Run run) {
+        if (!IsEnabled(name)) {
+            return;
+        }
+        optional<Measurement> best;
+        for (int repetition = 0; repetition < options_.repetitions; ++repetition) {
+            prepare();
+            ResetPeakMemory();
+            const size_t memory_before = ReadMemoryStatus("VmRSS:"sv);
+            const uint64_t allocations_before = allocation_count.load();
+            const uint64_t bytes_before = allocated_bytes.load();
+            const auto start = chrono::steady_clock::now();
+            run();
+            const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            Measurement measurement{name, params, ops, seconds,
+                                    allocation_count.load() - allocations_before,
+                                    allocated_bytes.load() - bytes_before,
+                                    ReadMemoryStatus("VmHWM:"sv) - memory_before};
+            if (!best || measurement.seconds < best->seconds) {
+                best = move(measurement);
+            }
+        }
+        cerr << best->GetKey() << ": "s << best->GetNsPerOp() << " ns/op"s << endl;
+        measurements_.push_back(move(*best));
+    }
+
+    template <typename Run>
+    void Measure(const string& name, const Params& params, uint64_t ops, Run run) {
+        Measure(name, params, ops, [] {}, run);
+    }
+
+    const vector<Measurement>& GetMeasurements() const {
+        return measurements_;
+    }
+
+private:
+    const Options& options_;
+    vector<Measurement> measurements_;
+};
+
+void RunQueryBenchmarks(BenchmarkRunner& runner, const Options& options, mt19937& generator,
+                        const vector<string>& dictionary, const SearchServer& search_server, Params params) {
+    for (const int query_words : options.query_word_counts) {
+        for (const double minus_prob : options.minus_probs) {
+            vector<string> queries;
+            for (int i = 0; i < options.query_count; ++i) {
+                queries.push_back(GenerateQuery(generator, dictionary, query_words, minus_prob));
+            }
+            vector<int> document_ids;
+            for (int i = 0; i < options.query_count * MATCHED_DOCUMENTS_PER_QUERY; ++i) {
+                document_ids.push_back(uniform_int_distribution<int>(0, params.documents - 1)(generator));
+            }
+
+            const auto find_top_documents = [&](const auto& policy) {
+                return [&search_server, &queries, policy] {
+                    for (const string& query : queries) {
+                        search_server.FindTopDocuments(policy, query);
+                    }
+                };
+            };
+            const auto match_document = [&](const auto& policy) {
+                return [&search_server, &queries, &document_ids, policy] {
+                    for (size_t i = 0; i < document_ids.size(); ++i) {
+                        search_server.MatchDocument(policy, queries[i / MATCHED_DOCUMENTS_PER_QUERY], document_ids[i]);
+                    }
+                };
+            };
+
+            params.query_words = query_words;
+            params.minus_prob = minus_prob;
+            params.threads = -1;
+            runner.Measure("find_top_documents_seq"s, params, queries.size(), find_top_documents(execution::seq));
+            runner.Measure("match_document_seq"s, params, document_ids.size(), match_document(execution::seq));
+            for (const size_t thread_count : options.thread_counts) {
+                tbb::global_control parallelism(tbb::global_control::max_allowed_parallelism, thread_count);
+                params.threads = static_cast<int>(thread_count);
+                runner.Measure("find_top_documents_par"s, params, queries.size(), find_top_documents(execution::par));
+                runner.Measure("match_document_par"s, params, document_ids.size(), match_document(execution::par));
+                runner.Measure("process_queries"s, params, queries.size(), [&search_server, &queries] {
+                    ProcessQueries(search_server, queries);
+                });
+            }
+        }
+    }
+}
+
+void RunConcurrentMapBenchmarks(BenchmarkRunner& runner, const Options& options) {
+    for (const size_t thread_count : options.thread_counts) {
+        Params params;
+        params.threads = static_cast<int>(thread_count);
+        runner.Measure("concurrent_map_increment"s, params, CONCURRENT_MAP_INCREMENTS, [thread_count] {
+            ConcurrentMap<int, int> increments(101);
+            vector<thread> threads;
+            for (size_t t = 0; t < thread_count; ++t) {
+                threads.emplace_back([&increments, t, thread_count] {
+                    mt19937 generator(t);
+                    for (size_t i = t; i < CONCURRENT_MAP_INCREMENTS; i += thread_count) {
+                        increments[generator() % 10'000].ref_to_value += 1;
+                    }
+                });
+            }
+            for (thread& t : threads) {
+                t.join();
+            }
+        });
+    }
+}
+
+vector<Measurement> RunBenchmarks(const Options& options) {
+    BenchmarkRunner runner(options);
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, DICTIONARY_SIZE, MAX_WORD_LENGTH);
+
+    for (const int document_count : options.document_counts) {
+        const auto documents = GenerateQueries(generator, dictionary, document_count, DOCUMENT_WORD_COUNT);
+        const Params params{document_count};
+
+        // Разбиение на слова, которое AddDocument делает для каждого документа
+        size_t word_count = 0;
+        runner.Measure("split_into_words"s, params, documents.size(), [&] {
+            for (const string& document : documents) {
+                ForEachWord(document, [&word_count](string_view word, bool has_control) {
+                    word_count += !word.empty() && !has_control;
+                });
+            }
+        });
+        if (runner.IsEnabled("split_into_words"s) && word_count == 0) {
+            throw logic_error("No words in documents"s);
+        }
+
+        for (const int stop_word_count : options.stop_word_counts) {
+            string stop_words;
+            for (int i = 0; i < min(stop_word_count, DICTIONARY_SIZE); ++i) {
+                stop_words += (i == 0 ? ""s : " "s) + dictionary[i];
+            }
+            Params server_params = params;
+            server_params.stop_words = stop_word_count == 1 ? -1 : stop_word_count;
+
+            optional<SearchServer> search_server;
+            runner.Measure("add_document"s, server_params, documents.size(), [&] {
+                search_server.emplace(stop_words);
+            }, [&] {
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    search_server->AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+                }
+            });
+            if (!runner.IsEnabled("add_document"s)) {
+                search_server.emplace(stop_words);
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    search_server->AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+                }
+            }
+
+            optional<SearchServer> removed_server;
+            runner.Measure("remove_document"s, server_params, documents.size(), [&] {
+                removed_server.emplace(*search_server);
+            }, [&] {
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    removed_server->RemoveDocument(static_cast<int>(i));
+                }
+            });
+            removed_server.reset();
+
+            RunQueryBenchmarks(runner, options, generator, dictionary, *search_server, server_params);
+        }
+    }
+    RunConcurrentMapBenchmarks(runner, options);
+    return runner.GetMeasurements();
+}
+
+void WriteJson(ostream& output, const vector<Measurement>& measurements) {
+    output << "{\"benchmarks\": [\n"s;
+    for (size_t i = 0; i < measurements.size(); ++i) {
+        const Measurement& measurement = measurements[i];
+        output << "{\"key\": \""s << measurement.GetKey() << "\", \"name\": \""s << measurement.name << '"';
+        if (measurement.params.documents >= 0) {
+            output << ", \"documents\": "s << measurement.params.documents;
+        }
+        if (measurement.params.query_words >= 0) {
+            output << ", \"query_words\": "s << measurement.params.query_words;
+        }
+        if (measurement.params.minus_prob >= 0) {
+            output << ", \"minus_prob\": "s << measurement.params.minus_prob;
+        }
+        if (measurement.params.threads >= 0) {
+            output << ", \"threads\": "s << measurement.params.threads;
+        }
+        if (measurement.params.stop_words >= 0) {
+            output << ", \"stop_words\": "s << measurement.params.stop_words;
+        }
+        output << ", \"ops\": "s << measurement.ops
+               << ", \"ns_per_op\": "s << measurement.GetNsPerOp()
+               << ", \"ops_per_sec\": "s << (measurement.seconds > 0 ? measurement.ops / measurement.seconds : 0)
+               << ", \"allocations_per_op\": "s << static_cast<double>(measurement.allocations) / max<uint64_t>(1, measurement.ops)
+               << ", \"allocated_bytes_per_op\": "s << static_cast<double>(measurement.allocated_bytes) / max<uint64_t>(1, measurement.ops)
+               << ", \"peak_rss_kb\": "s << measurement.peak_rss_kb << '}'
+               << (i + 1 < measurements.size() ? ",\n"s : "\n"s);
+    }
+    output << "]}\n"s;
+}
+
+// Читает ns_per_op из результата, записанного WriteJson: по замеру на строку
+map<string, double> ReadBaseline(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw invalid_argument("Cannot open baseline "s + path);
+    }
+    map<string, double> baseline;
+    for (string line; getline(input, line);) {
+        const string key_field = "\"key\": \""s;
+        const string ns_field = "\"ns_per_op\": "s;
+        const size_t key_position = line.find(key_field);
+        const size_t ns_position = line.find(ns_field);
+        if (key_position == string::npos || ns_position == string::npos) {
+            continue;
+        }
+        const size_t key_begin = key_position + key_field.size();
+        const string key = line.substr(key_begin, line.find('"', key_begin) - key_begin);
+        baseline[key] = stod(line.substr(ns_position + ns_field.size()));
+    }
+    return baseline;
+}
+
+// Возвращает число регрессий
+int Compare(ostream& output, const vector<Measurement>& measurements, const map<string, double>& baseline, double threshold) {
+    int regression_count = 0;
+    output << left << setw(80) << "benchmark"s << right << setw(14) << "base ns/op"s
+           << setw(14) << "ns/op"s << setw(10) << "change"s << '\n';
+    output << fixed << setprecision(1);
+    for (const Measurement& measurement : measurements) {
+        const string key = measurement.GetKey();
+        const double ns_per_op = measurement.GetNsPerOp();
+        output << left << setw(80) << key << right;
+        const auto it = baseline.find(key);
+        if (it == baseline.end() || it->second <= 0) {
+            output << setw(14) << "-"s << setw(14) << ns_per_op << "  new\n"s;
+            continue;
+        }
+        const double change = ns_per_op / it->second - 1;
+        output << setw(14) << it->second << setw(14) << ns_per_op << setw(9) << change * 100 << '%';
+        if (change > threshold) {
+            output << "  REGRESSION"s;
+            ++regression_count;
+        } else if (change < -threshold) {
+            output << "  improved"s;
+        }
+        output << '\n';
+    }
+    return regression_count;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = ParseOptions(argc, argv);
+        const vector<Measurement> measurements = RunBenchmarks(options);
+
+        if (options.output_path.empty()) {
+            WriteJson(cout, measurements);
+        } else {
+            ofstream output(options.output_path);
+            WriteJson(output, measurements);
+        }
+
+        if (!options.compare_path.empty()) {
+            const int regression_count = Compare(cerr, measurements, ReadBaseline(options.compare_path), options.threshold);
+            cerr << regression_count << " regressions"s << endl;
+            return regression_count > 0 ? 1 : 0;
+        }
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Разбор аргументов программ из каталога benchmark: каждый аргумент имеет вид --name=value
+
+inline std::vector<std::pair<std::string, std::string>> ParseArguments(int argc, char* argv[]) {
+    using namespace std::string_literals;
+    std::vector<std::pair<std::string, std::string>> arguments;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (argument.compare(0, 2, "--"s) != 0 || equals == std::string::npos) {
+            throw std::invalid_argument("Unknown argument: "s + argument);
+        }
+        arguments.emplace_back(argument.substr(2, equals - 2), argument.substr(equals + 1));
+    }
+    return arguments;
+}
+
+// Значения через запятую, parse преобразует одно значение
+template <typename Parse>
+auto ParseList(const std::string& text, Parse parse) {
+    using namespace std::string_literals;
+    std::vector<decltype(parse(text))> values;
+    std::istringstream input(text);
+    for (std::string item; std::getline(input, item, ',');) {
+        values.push_back(parse(item));
+    }
+    if (values.empty()) {
+        throw std::invalid_argument("Empty list: "s + text);
+    }
+    return values;
+}
@@ -0,0 +1,446 @@
+// Нагрузочный тест: поток запросов к SnapshotSearchServer с заданной интенсивностью
+// или от заданного числа клиентов, вперемешку с добавлением и удалением документов.
+// Сборка из каталога search-server:
+//   g++ -std=c++17 -O2 -I. benchmark/load_generator.cpp $(ls *.cpp | grep -v main.cpp) -o search_server_load -ltbb -lpthread
+// Параметры:
+//   --corpus=docs.txt     документы по одному на строку, id — номер строки
+//   --documents=10000     иначе случайный корпус такого размера
+//   --stop-words="a b"    стоп-слова, для случайного корпуса по умолчанию первое слово словаря
+//   --auto-stop-share=1   доля документов, начиная с которой слово становится автоматическим стоп-словом
+//   --query-log=log.txt   запросы по одному на строку, повторяются по кругу
+//   --query-pool=1000     иначе случайные запросы из пула такого размера
+//   --query-words=3       слов в случайном запросе
+//   --minus-prob=0        вероятность минус-слова в случайном запросе
+//   --zipf=1              показатель закона Ципфа для выбора запроса из пула
+//   --rate=0              запросов в секунду (открытая модель), 0 — закрытая модель
+//   --clients=N           клиентов закрытой модели или исполнителей открытой, N — число ядер
+//   --add-rate=0          добавлений документов в секунду
+//   --remove-rate=0       удалений документов в секунду
+//   --duration=10         длительность в секундах
+//   --interval=1          период отчёта в секундах
+// В открытой модели запросы назначаются на моменты start + i / rate, задержка считается
+// от назначенного момента, поэтому включает ожидание свободного исполнителя. Запросы,
+// не начатые до конца теста, выводятся как missed — признак того, что rate не выдержан
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "command_line.h"
+#include "generators.h"
+#include "histogram.h"
+#include "snapshot_search_server.h"
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+constexpr int DICTIONARY_SIZE = 1000;
+constexpr int MAX_WORD_LENGTH = 10;
+constexpr int DOCUMENT_WORD_COUNT = 70;
+
+struct Options {
+    string corpus_path;
+    int document_count = 10000;
+    optional<string> stop_words;
+    double auto_stop_share = 1;
+    string query_log_path;
+    int query_pool_size = 1000;
+    int query_word_count = 3;
+    double minus_prob = 0;
+    double zipf_exponent = 1;
+    double rate = 0;
+    int client_count = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    double add_rate = 0;
+    double remove_rate = 0;
+    double duration = 10;
+    double interval = 1;
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (const auto& [name, value] : ParseArguments(argc, argv)) {
+        if (name == "corpus"s) {
+            options.corpus_path = value;
+        } else if (name == "documents"s) {
+            options.document_count = max(0, stoi(value));
+        } else if (name == "stop-words"s) {
+            options.stop_words = value;
+        } else if (name == "auto-stop-share"s) {
+            options.auto_stop_share = stod(value);
+        } else if (name == "query-log"s) {
+            options.query_log_path = value;
+        } else if (name == "query-pool"s) {
+            options.query_pool_size = max(1, stoi(value));
+        } else if (name == "query-words"s) {
+            options.query_word_count = max(1, stoi(value));
+        } else if (name == "minus-prob"s) {
+            options.minus_prob = stod(value);
+        } else if (name == "zipf"s) {
+            options.zipf_exponent = stod(value);
+        } else if (name == "rate"s) {
+            options.rate = max(0.0, stod(value));
+        } else if (name == "clients"s) {
+            options.client_count = max(1, stoi(value));
+        } else if (name == "add-rate"s) {
+            options.add_rate = max(0.0, stod(value));
+        } else if (name == "remove-rate"s) {
+            options.remove_rate = max(0.0, stod(value));
+        } else if (name == "duration"s) {
+            options.duration = stod(value);
+        } else if (name == "interval"s) {
+            options.interval = stod(value);
+        } else {
+            throw invalid_argument("Unknown argument: --"s + name);
+        }
+    }
+    if (options.duration <= 0 || options.interval <= 0) {
+        throw invalid_argument("Duration and interval must be positive"s);
+    }
+    return options;
+}
+
+// Непустые строки файла
+vector<string> ReadLines(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw invalid_argument("Cannot open "s + path);
+    }
+    vector<string> lines;
+    for (string line; getline(input, line);) {
+        if (!line.empty()) {
+            lines.push_back(move(line));
+        }
+    }
+    if (lines.empty()) {
+        throw invalid_argument("No lines in "s + path);
+    }
+    return lines;
+}
+
+// Запросы из журнала по порядку или из пула с частотами по закону Ципфа:
+// k-й по популярности запрос выбирается с вероятностью, пропорциональной 1 / k^s
+class QuerySource {
+public:
+    QuerySource(vector<string> queries, bool replay, double zipf_exponent)
+        : queries_(move(queries))
+        , replay_(replay) {
+        if (!replay_) {
+            double total = 0;
+            for (size_t rank = 1; rank <= queries_.size(); ++rank) {
+                total += 1 / pow(static_cast<double>(rank), zipf_exponent);
+                cumulative_.push_back(total);
+            }
+        }
+    }
+
+    string_view Get(uint64_t request_index, mt19937& generator) const {
+        if (replay_) {
+            return queries_[request_index % queries_.size()];
+        }
+        const double point = uniform_real_distribution<double>(0, cumulative_.back())(generator);
+        const size_t index = upper_bound(cumulative_.begin(), cumulative_.end(), point) - cumulative_.begin();
+        return queries_[min(index, queries_.size() - 1)];
+    }
+
+private:
+    vector<string> queries_;
+    bool replay_;
+    vector<double> cumulative_;
+};
+
+// Результаты, собранные за один период отчёта. Запрос относится к периоду, в котором он завершился
+struct IntervalStats {
+    Histogram latencies;
+    atomic<uint64_t> errors = 0;
+    atomic<uint64_t> adds = 0;
+    atomic<uint64_t> removes = 0;
+};
+
+class LoadTest {
+public:
+    LoadTest(const Options& options, SnapshotSearchServer& server, const QuerySource& queries,
+             vector<string> new_documents, int first_new_id)
+        : options_(options)
+        , server_(server)
+        , queries_(queries)
+        , new_documents_(move(new_documents))
+        , first_new_id_(first_new_id)
+        , interval_(chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.interval)))
+        // Последний период собирает всё, что завершилось после конца теста
+        , intervals_(static_cast<size_t>(ceil(options.duration / options.interval)) + 1) {
+    }
+
+    void Run() {
+        start_ = Clock::now();
+        end_ = start_ + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options_.duration));
+
+        vector<thread> threads;
+        for (int client = 0; client < options_.client_count; ++client) {
+            threads.emplace_back([this, client] {
+                mt19937 generator(client);
+                if (options_.rate > 0) {
+                    RunOpenLoopWorker(generator);
+                } else {
+                    RunClosedLoopClient(generator);
+                }
+            });
+        }
+        if (options_.add_rate > 0 || options_.remove_rate > 0) {
+            threads.emplace_back([this] {
+                RunWriter();
+            });
+        }
+
+        PrintHeader();
+        for (size_t i = 0; i + 1 < intervals_.size(); ++i) {
+            this_thread::sleep_until(min(start_ + interval_ * static_cast<Clock::rep>(i + 1), end_));
+            PrintInterval(i);
+        }
+        for (thread& thread : threads) {
+            thread.join();
+        }
+        PrintSummary();
+    }
+
+private:
+    const Options& options_;
+    SnapshotSearchServer& server_;
+    const QuerySource& queries_;
+    const vector<string> new_documents_;
+    const int first_new_id_;
+    const Clock::duration interval_;
+    vector<IntervalStats> intervals_;
+    Histogram write_latencies_;
+    atomic<uint64_t> next_request_ = 0;
+    atomic<uint64_t> started_requests_ = 0;
+    Clock::time_point start_;
+    Clock::time_point end_;
+
+    IntervalStats& GetInterval(Clock::time_point time) {
+        const size_t index = static_cast<size_t>((time - start_) / interval_);
+        return intervals_[min(index, intervals_.size() - 1)];
+    }
+
+    void Execute(uint64_t request_index, Clock::time_point issued, mt19937& generator) {
+        const string_view query = queries_.Get(request_index, generator);
+        bool failed = false;
+        try {
+            server_.FindTopDocuments(query);
+        } catch (const exception&) {
+            failed = true;
+        }
+        const Clock::time_point finish = Clock::now();
+        IntervalStats& stats = GetInterval(finish);
+        if (failed) {
+            stats.errors.fetch_add(1, memory_order_relaxed);
+        } else {
+            stats.latencies.Record(chrono::duration_cast<chrono::nanoseconds>(finish - issued).count());
+        }
+    }
+
+    void RunOpenLoopWorker(mt19937& generator) {
+        const chrono::duration<double> period(1 / options_.rate);
+        while (true) {
+            const uint64_t index = next_request_.fetch_add(1, memory_order_relaxed);
+            const Clock::time_point scheduled = start_ + chrono::duration_cast<Clock::duration>(period * static_cast<double>(index));
+            if (scheduled >= end_) {
+                break;
+            }
+            this_thread::sleep_until(scheduled);
+            // Отставшие исполнители не начинают запросы после конца теста
+            if (Clock::now() >= end_) {
+                break;
+            }
+            started_requests_.fetch_add(1, memory_order_relaxed);
+            Execute(index, scheduled, generator);
+        }
+    }
+
+    void RunClosedLoopClient(mt19937& generator) {
+        for (Clock::time_point issued = Clock::now(); issued < end_; issued = Clock::now()) {
+            const uint64_t index = next_request_.fetch_add(1, memory_order_relaxed);
+            started_requests_.fetch_add(1, memory_order_relaxed);
+            Execute(index, issued, generator);
+        }
+    }
+
+    // Добавления и удаления идут по своим расписаниям в одном потоке,
+    // так как SnapshotSearchServer всё равно публикует изменения по одному
+    void RunWriter() {
+        mt19937 generator(options_.client_count);
+        vector<int> document_ids;
+        for (int id = 0; id < first_new_id_; ++id) {
+            document_ids.push_back(id);
+        }
+
+        const auto get_period = [](double rate) {
+            return chrono::duration_cast<Clock::duration>(chrono::duration<double>(1 / rate));
+        };
+        const Clock::time_point never = Clock::time_point::max();
+        Clock::time_point next_add = options_.add_rate > 0 ? start_ : never;
+        Clock::time_point next_remove = options_.remove_rate > 0 ? start_ : never;
+        int next_id = first_new_id_;
+
+        while (true) {
+            const bool add = next_add <= next_remove;
+            const Clock::time_point scheduled = add ? next_add : next_remove;
+            if (scheduled >= end_) {
+                break;
+            }
+            this_thread::sleep_until(scheduled);
+            const Clock::time_point write_start = Clock::now();
+            if (write_start >= end_) {
+                break;
+            }
+            if (add) {
+                const string& text = new_documents_[(next_id - first_new_id_) % new_documents_.size()];
+                server_.AddDocument(next_id, text, DocumentStatus::ACTUAL, {1, 2, 3});
+                document_ids.push_back(next_id++);
+                next_add += get_period(options_.add_rate);
+            } else {
+                if (!document_ids.empty()) {
+                    const size_t index = uniform_int_distribution<size_t>(0, document_ids.size() - 1)(generator);
+                    swap(document_ids[index], document_ids.back());
+                    server_.RemoveDocument(document_ids.back());
+                    document_ids.pop_back();
+                }
+                next_remove += get_period(options_.remove_rate);
+            }
+            const Clock::time_point finish = Clock::now();
+            write_latencies_.Record(chrono::duration_cast<chrono::nanoseconds>(finish - write_start).count());
+            (add ? GetInterval(finish).adds : GetInterval(finish).removes).fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    static double ToMicroseconds(uint64_t nanoseconds) {
+        return nanoseconds / 1000.0;
+    }
+
+    void PrintHeader() const {
+        cout << setw(8) << "time_s"s << setw(10) << "qps"s << setw(10) << "p50_us"s << setw(10) << "p90_us"s
+             << setw(10) << "p99_us"s << setw(10) << "p999_us"s << setw(10) << "max_us"s << setw(8) << "errors"s
+             << setw(8) << "adds"s << setw(8) << "removes"s << endl;
+    }
+
+    void PrintInterval(size_t index) const {
+        const IntervalStats& stats = intervals_[index];
+        const HistogramSnapshot latencies = stats.latencies.GetSnapshot();
+        const double seconds = min(options_.interval, options_.duration - options_.interval * index);
+        cout << fixed << setprecision(1)
+             << setw(8) << options_.interval * index + seconds << setw(10) << latencies.count / seconds
+             << setw(10) << ToMicroseconds(latencies.GetPercentile(50)) << setw(10) << ToMicroseconds(latencies.GetPercentile(90))
+             << setw(10) << ToMicroseconds(latencies.GetPercentile(99)) << setw(10) << ToMicroseconds(latencies.GetPercentile(99.9))
+             << setw(10) << ToMicroseconds(latencies.GetPercentile(100)) << setw(8) << stats.errors.load()
+             << setw(8) << stats.adds.load() << setw(8) << stats.removes.load() << endl;
+    }
+
+    void PrintSummary() const {
+        HistogramSnapshot latencies;
+        uint64_t errors = 0;
+        for (const IntervalStats& stats : intervals_) {
+            latencies.Merge(stats.latencies.GetSnapshot());
+            errors += stats.errors.load();
+        }
+        const HistogramSnapshot writes = write_latencies_.GetSnapshot();
+        const uint64_t started = started_requests_.load();
+
+        cout << fixed << setprecision(1);
+        cout << "mode: "s << (options_.rate > 0 ? "open loop"s : "closed loop"s) << ", clients: "s << options_.client_count;
+        if (options_.rate > 0) {
+            const uint64_t scheduled = static_cast<uint64_t>(ceil(options_.duration * options_.rate));
+            cout << ", target qps: "s << options_.rate << ", missed: "s << (scheduled > started ? scheduled - started : 0);
+        }
+        cout << endl;
+        cout << "requests: "s << latencies.count << ", errors: "s << errors
+             << ", qps: "s << latencies.count / options_.duration << endl;
+        cout << "latency us: mean "s << latencies.GetMean() / 1000
+             << ", p50 "s << ToMicroseconds(latencies.GetPercentile(50))
+             << ", p90 "s << ToMicroseconds(latencies.GetPercentile(90))
+             << ", p99 "s << ToMicroseconds(latencies.GetPercentile(99))
+             << ", p99.9 "s << ToMicroseconds(latencies.GetPercentile(99.9))
+             << ", max "s << ToMicroseconds(latencies.GetPercentile(100)) << endl;
+        if (writes.count > 0) {
+            cout << "writes: "s << writes.count << ", latency us: p50 "s << ToMicroseconds(writes.GetPercentile(50))
+                 << ", p99 "s << ToMicroseconds(writes.GetPercentile(99))
+                 << ", max "s << ToMicroseconds(writes.GetPercentile(100)) << endl;
+        }
+        cout << "documents: "s << server_.GetDocumentCount() << endl;
+    }
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = ParseOptions(argc, argv);
+        mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator, DICTIONARY_SIZE, MAX_WORD_LENGTH);
+
+        const vector<string> documents = options.corpus_path.empty()
+            ? GenerateQueries(generator, dictionary, options.document_count, DOCUMENT_WORD_COUNT)
+            : ReadLines(options.corpus_path);
+        // Новые документы случайного корпуса генерируются так же, корпус из файла добавляется повторно
+        vector<string> new_documents = options.corpus_path.empty()
+            ? GenerateQueries(generator, dictionary, max(1, static_cast<int>(ceil(options.add_rate * options.duration))), DOCUMENT_WORD_COUNT)
+            : documents;
+
+        vector<string> queries;
+        if (options.query_log_path.empty()) {
+            for (int i = 0; i < options.query_pool_size; ++i) {
+                queries.push_back(GenerateQuery(generator, dictionary, options.query_word_count, options.minus_prob));
+            }
+        } else {
+            queries = ReadLines(options.query_log_path);
+        }
+        const QuerySource query_source(move(queries), !options.query_log_path.empty(), options.zipf_exponent);
+
+        SnapshotSearchServer server(options.stop_words.value_or(options.corpus_path.empty() ? dictionary[0] : ""s));
+        vector<DocumentInput> inputs;
+        inputs.reserve(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            inputs.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        const Clock::time_point load_start = Clock::now();
+        server.AddDocuments(inputs);
+        cout << "loaded "s << documents.size() << " documents in "s
+             << chrono::duration_cast<chrono::milliseconds>(Clock::now() - load_start).count() << " ms"s << endl;
+
+        if (options.auto_stop_share < 1) {
+            const double share = options.auto_stop_share;
+            server.ApplyUpdate([share](SearchServer& search_server) {
+                search_server.SetAutoStopWords(share);
+            });
+        }
+        {
+            const auto snapshot = server.GetSnapshot();
+            const IndexMemoryUsage memory = snapshot->GetIndexMemoryUsage();
+            const auto auto_stop_words = snapshot->GetAutoStopWords();
+            size_t auto_stop_postings = 0;
+            for (const auto& [word, document_freq] : auto_stop_words) {
+                auto_stop_postings += document_freq;
+            }
+            cout << "index: "s << memory.posting_count << " postings, "s << memory.bytes / 1024 << " KB, auto stop words: "s
+                 << auto_stop_words.size() << " with "s << auto_stop_postings << " postings"s << endl;
+        }
+
+        LoadTest load_test(options, server, query_source, move(new_documents), static_cast<int>(documents.size()));
+        load_test.Run();
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 2;
+    }
+    return 0;
+}
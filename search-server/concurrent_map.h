@@ -1,25 +1,33 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <iterator>
 #include <map>
 #include <mutex>
+#include <numeric>
+#include <utility>
 #include <vector>
 
-using namespace std::string_literals;
+// Размер строки кэша. Корзины выровнены по нему, чтобы потоки, работающие
+// с соседними корзинами, не делили одну строку
+constexpr size_t CONCURRENT_MAP_CACHE_LINE = 64;
 
-template <typename Key, typename Value>
+// Словарь, разбитый на корзины со своими мьютексами. Ключ — любой тип с Hash и operator==,
+// BuildOrdinaryMap дополнительно требует operator<.
+// Каждая корзина — таблица с открытой адресацией и линейным пробированием. Таблица
+// растёт под мьютексом своей корзины, остальные корзины в это время доступны.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class ConcurrentMap {
-public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
-
-    struct Bucket {
-        std::mutex mutex_value;
-        std::map<Key, Value> container;
-    };
+    struct Bucket;
 
+public:
     struct Access {
-        Access(const Key& key, Bucket& bucket)
+        Access(const Key& key, uint64_t hash, Bucket& bucket)
             : guard(bucket.mutex_value)
-            , ref_to_value(bucket.container[key])
+            , ref_to_value(FindOrInsert(bucket, key, hash))
         {}
 
         std::lock_guard<std::mutex> guard;
@@ -27,31 +35,211 @@ public:
     };
 
     explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count)
+        : buckets_(std::max<size_t>(bucket_count, 1))
     {}
 
     Access operator[](const Key& key) {
-        uint64_t id = key;
-        Bucket& bucket = buckets_[id % buckets_.size()];
-        return {key, bucket};
+        const uint64_t hash = ComputeHash(key);
+        return {key, hash, GetBucket(hash)};
+    }
+
+    void Erase(const Key& key);
+
+    size_t GetSize() const;
+
+    // Обходит все пары, корзины обрабатываются параллельно при policy = par.
+    // Во время обхода корзины её нельзя менять из callback
+    template <typename ExecutionPolicy, typename Callback>
+    void ForEach(const ExecutionPolicy& policy, Callback callback);
+
+    std::map<Key, Value> BuildOrdinaryMap();
+    // Корзины выгружаются и сортируются параллельно, затем сливаются попарно
+    template <typename ExecutionPolicy>
+    std::map<Key, Value> BuildOrdinaryMap(const ExecutionPolicy& policy);
+
+private:
+    struct Slot {
+        Key key{};
+        Value value{};
+        uint64_t hash = 0;
+        bool is_used = false;
+    };
+
+    struct alignas(CONCURRENT_MAP_CACHE_LINE) Bucket {
+        mutable std::mutex mutex_value;
+        // Размер таблицы — степень двойки или 0
+        std::vector<Slot> slots;
+        size_t size = 0;
     };
 
-    void Erase(const Key& key) {
-        uint64_t id = key;
-        Bucket& bucket = buckets_[id % buckets_.size()];
+    std::vector<Bucket> buckets_;
+
+    static uint64_t ComputeHash(const Key& key) {
+        // Перемешивание Фибоначчи: std::hash целых чисел — тождественная функция
+        return static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    Bucket& GetBucket(uint64_t hash) {
+        // Корзину выбирают старшие биты, место в таблице — младшие
+        return buckets_[(hash >> 32) % buckets_.size()];
+    }
+
+    static Value& FindOrInsert(Bucket& bucket, const Key& key, uint64_t hash);
+    static size_t Find(const Bucket& bucket, const Key& key, uint64_t hash);
+    static void Grow(Bucket& bucket);
+};
+
+template <typename Key, typename Value, typename Hash>
+size_t ConcurrentMap<Key, Value, Hash>::Find(const Bucket& bucket, const Key& key, uint64_t hash) {
+    if (bucket.slots.empty()) {
+        return bucket.slots.size();
+    }
+    const size_t mask = bucket.slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = bucket.slots[i];
+        if (!slot.is_used) {
+            return bucket.slots.size();
+        }
+        if (slot.hash == hash && slot.key == key) {
+            return i;
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+Value& ConcurrentMap<Key, Value, Hash>::FindOrInsert(Bucket& bucket, const Key& key, uint64_t hash) {
+    const size_t position = Find(bucket, key, hash);
+    if (position != bucket.slots.size()) {
+        return bucket.slots[position].value;
+    }
+    // Заполненность таблицы не выше 3/4
+    if ((bucket.size + 1) * 4 > bucket.slots.size() * 3) {
+        Grow(bucket);
+    }
+    const size_t mask = bucket.slots.size() - 1;
+    size_t i = hash & mask;
+    while (bucket.slots[i].is_used) {
+        i = (i + 1) & mask;
+    }
+    Slot& slot = bucket.slots[i];
+    slot.key = key;
+    slot.hash = hash;
+    slot.is_used = true;
+    ++bucket.size;
+    return slot.value;
+}
+
+template <typename Key, typename Value, typename Hash>
+void ConcurrentMap<Key, Value, Hash>::Grow(Bucket& bucket) {
+    std::vector<Slot> slots(std::max<size_t>(bucket.slots.size() * 2, 8));
+    const size_t mask = slots.size() - 1;
+    for (Slot& slot : bucket.slots) {
+        if (slot.is_used) {
+            size_t i = slot.hash & mask;
+            while (slots[i].is_used) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = std::move(slot);
+        }
+    }
+    bucket.slots = std::move(slots);
+}
+
+template <typename Key, typename Value, typename Hash>
+void ConcurrentMap<Key, Value, Hash>::Erase(const Key& key) {
+    const uint64_t hash = ComputeHash(key);
+    Bucket& bucket = GetBucket(hash);
+    std::lock_guard guard(bucket.mutex_value);
+    size_t hole = Find(bucket, key, hash);
+    if (hole == bucket.slots.size()) {
+        return;
+    }
+    // Сдвигаем назад следующие элементы цепочки, чтобы поиск не обрывался на дыре
+    const size_t mask = bucket.slots.size() - 1;
+    for (size_t i = (hole + 1) & mask; bucket.slots[i].is_used; i = (i + 1) & mask) {
+        const size_t home = bucket.slots[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            bucket.slots[hole] = std::move(bucket.slots[i]);
+            hole = i;
+        }
+    }
+    bucket.slots[hole] = Slot{};
+    --bucket.size;
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t ConcurrentMap<Key, Value, Hash>::GetSize() const {
+    size_t size = 0;
+    for (const Bucket& bucket : buckets_) {
         std::lock_guard guard(bucket.mutex_value);
-        bucket.container.erase(key);
+        size += bucket.size;
     }
+    return size;
+}
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (auto& [mutex, container] : buckets_) {
-            std::lock_guard guard(mutex);
-            result.insert(container.begin(), container.end());
+template <typename Key, typename Value, typename Hash>
+template <typename ExecutionPolicy, typename Callback>
+void ConcurrentMap<Key, Value, Hash>::ForEach(const ExecutionPolicy& policy, Callback callback) {
+    std::for_each(policy, buckets_.begin(), buckets_.end(), [&callback](Bucket& bucket) {
+        std::lock_guard guard(bucket.mutex_value);
+        for (Slot& slot : bucket.slots) {
+            if (slot.is_used) {
+                callback(static_cast<const Key&>(slot.key), slot.value);
+            }
         }
-        return result;
+    });
+}
+
+template <typename Key, typename Value, typename Hash>
+std::map<Key, Value> ConcurrentMap<Key, Value, Hash>::BuildOrdinaryMap() {
+    return BuildOrdinaryMap(std::execution::seq);
+}
+
+template <typename Key, typename Value, typename Hash>
+template <typename ExecutionPolicy>
+std::map<Key, Value> ConcurrentMap<Key, Value, Hash>::BuildOrdinaryMap(const ExecutionPolicy& policy) {
+    using Entries = std::vector<std::pair<Key, Value>>;
+    const auto less_key = [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
     };
 
-private:
-    std::vector<Bucket> buckets_;
-};
+    std::vector<Entries> parts(buckets_.size());
+    std::vector<size_t> indexes(buckets_.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+        Bucket& bucket = buckets_[index];
+        {
+            std::lock_guard guard(bucket.mutex_value);
+            parts[index].reserve(bucket.size);
+            for (const Slot& slot : bucket.slots) {
+                if (slot.is_used) {
+                    parts[index].emplace_back(slot.key, slot.value);
+                }
+            }
+        }
+        std::sort(parts[index].begin(), parts[index].end(), less_key);
+    });
+
+    // Попарное слияние: на каждом шаге число частей уменьшается вдвое
+    while (parts.size() > 1) {
+        std::vector<Entries> merged((parts.size() + 1) / 2);
+        indexes.resize(merged.size());
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            if (2 * index + 1 == parts.size()) {
+                merged[index] = std::move(parts[2 * index]);
+                return;
+            }
+            const Entries& lhs = parts[2 * index];
+            const Entries& rhs = parts[2 * index + 1];
+            merged[index].reserve(lhs.size() + rhs.size());
+            std::merge(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), std::back_inserter(merged[index]), less_key);
+        });
+        parts = std::move(merged);
+    }
+
+    std::map<Key, Value> result;
+    for (auto& [key, value] : parts.front()) {
+        result.emplace_hint(result.end(), std::move(key), std::move(value));
+    }
+    return result;
+}
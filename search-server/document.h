@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 using namespace std;
 
@@ -21,6 +23,14 @@ struct Document {
     int rating = 0;
 };
 
+// Документ для пакетного добавления в SearchServer::AddDocuments
+struct DocumentInput {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
 std::ostream& operator<<(std::ostream& out, const Document& document);
 
 void PrintDocument(const Document& document);
\ No newline at end of file
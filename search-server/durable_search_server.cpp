@@ -0,0 +1,153 @@
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "durable_search_server.h"
+
+using namespace std;
+
+namespace {
+
+const std::string INDEX_FILE_PREFIX = "index-"s;
+const std::string INDEX_FILE_SUFFIX = ".bin"s;
+const std::string LOG_FILE_PREFIX = "operations-"s;
+const std::string LOG_FILE_SUFFIX = ".log"s;
+
+// Номер поколения из имени вида <prefix><N><suffix>, иначе false
+bool ParseGeneration(const std::string& name, const std::string& prefix, const std::string& suffix, uint64_t& generation) {
+    if (name.size() <= prefix.size() + suffix.size()
+        || name.compare(0, prefix.size(), prefix) != 0
+        || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+    const std::string number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+    if (number.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    generation = std::stoull(number);
+    return true;
+}
+
+void SyncPath(const std::filesystem::path& path, int flags) {
+    const int fd = open(path.c_str(), flags);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open "s + path.string());
+    }
+    const int result = fsync(fd);
+    close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Cannot sync "s + path.string());
+    }
+}
+
+} // namespace
+
+DurableSearchServer::DurableSearchServer(const std::string& directory, const std::string_view stop_words_text)
+    : directory_(directory)
+    , generation_(FindLastGeneration(directory_))
+    , search_server_(Recover(SearchServer(stop_words_text)))
+    , log_(std::make_unique<OperationLog>(GetLogPath(generation_).string())) {
+    RemoveStaleFiles();
+}
+
+void DurableSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    search_server_.AddDocument(document_id, document, status, ratings);
+    log_->LogAddDocument(document_id, document, status, ratings);
+}
+
+void DurableSearchServer::AddDocuments(const std::vector<DocumentInput>& documents) {
+    // При ошибке SearchServer добавляет документы до первого некорректного, их и пишем в журнал
+    const int count_before = search_server_.GetDocumentCount();
+    std::exception_ptr error;
+    try {
+        search_server_.AddDocuments(std::execution::par, documents);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    const size_t added_count = static_cast<size_t>(search_server_.GetDocumentCount() - count_before);
+    log_->LogAddDocuments(documents, added_count);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    const int count_before = search_server_.GetDocumentCount();
+    search_server_.RemoveDocument(document_id);
+    if (search_server_.GetDocumentCount() != count_before) {
+        log_->LogRemoveDocument(document_id);
+    }
+}
+
+void DurableSearchServer::Sync() {
+    log_->Sync();
+}
+
+void DurableSearchServer::Checkpoint() {
+    log_->Sync();
+
+    const uint64_t next_generation = generation_ + 1;
+    const auto index_path = GetIndexPath(next_generation);
+    auto temporary_path = index_path;
+    temporary_path += ".tmp"s;
+    search_server_.SaveIndex(temporary_path.string());
+    SyncPath(temporary_path, O_RDONLY);
+    // После переименования снимок N + 1 считается последним, журнал N больше не нужен
+    std::filesystem::rename(temporary_path, index_path);
+    SyncPath(directory_, O_RDONLY | O_DIRECTORY);
+
+    log_ = std::make_unique<OperationLog>(GetLogPath(next_generation).string());
+    generation_ = next_generation;
+    RemoveStaleFiles();
+}
+
+int DurableSearchServer::GetDocumentCount() const {
+    return search_server_.GetDocumentCount();
+}
+
+const SearchServer& DurableSearchServer::GetSearchServer() const {
+    return search_server_;
+}
+
+uint64_t DurableSearchServer::FindLastGeneration(const std::filesystem::path& directory) {
+    std::filesystem::create_directories(directory);
+    uint64_t last_generation = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        uint64_t generation = 0;
+        if (ParseGeneration(entry.path().filename().string(), INDEX_FILE_PREFIX, INDEX_FILE_SUFFIX, generation)) {
+            last_generation = std::max(last_generation, generation);
+        }
+    }
+    return last_generation;
+}
+
+std::filesystem::path DurableSearchServer::GetIndexPath(uint64_t generation) const {
+    return directory_ / (INDEX_FILE_PREFIX + std::to_string(generation) + INDEX_FILE_SUFFIX);
+}
+
+std::filesystem::path DurableSearchServer::GetLogPath(uint64_t generation) const {
+    return directory_ / (LOG_FILE_PREFIX + std::to_string(generation) + LOG_FILE_SUFFIX);
+}
+
+SearchServer DurableSearchServer::Recover(SearchServer empty_server) const {
+    // Поколение 0 — пустой индекс без снимка
+    SearchServer search_server = generation_ == 0
+                                 ? std::move(empty_server)
+                                 : SearchServer::LoadIndex(GetIndexPath(generation_).string());
+    OperationLog::Replay(GetLogPath(generation_).string(), search_server);
+    return search_server;
+}
+
+void DurableSearchServer::RemoveStaleFiles() const {
+    for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+        const std::string name = entry.path().filename().string();
+        uint64_t generation = 0;
+        const bool is_stale = ParseGeneration(name, INDEX_FILE_PREFIX, INDEX_FILE_SUFFIX + ".tmp"s, generation)
+                              || (ParseGeneration(name, INDEX_FILE_PREFIX, INDEX_FILE_SUFFIX, generation) && generation < generation_)
+                              || (ParseGeneration(name, LOG_FILE_PREFIX, LOG_FILE_SUFFIX, generation) && generation < generation_);
+        if (is_stale) {
+            std::filesystem::remove(entry.path());
+        }
+    }
+}
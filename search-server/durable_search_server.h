@@ -0,0 +1,65 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "operation_log.h"
+#include "search_server.h"
+
+// SearchServer, переживающий перезапуск процесса. В каталоге хранятся снимок индекса
+// index-<N>.bin (SaveIndex) и журнал operations-<N>.log с изменениями после него.
+// При открытии загружается последний снимок и поверх него воспроизводится журнал.
+// Checkpoint сохраняет снимок N + 1 и начинает новый журнал, после чего старые файлы
+// удаляются. Снимок публикуется переименованием, поэтому падение на любом шаге
+// оставляет согласованную пару файлов.
+class DurableSearchServer {
+public:
+    template <typename StringContainer>
+    DurableSearchServer(const std::string& directory, const StringContainer& stop_words);
+    DurableSearchServer(const std::string& directory, const std::string_view stop_words_text);
+
+    // Изменения пишутся в журнал только если SearchServer их принял
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<DocumentInput>& documents);
+    void RemoveDocument(int document_id);
+
+    // Гарантирует, что все сделанные изменения на диске
+    void Sync();
+    // Сворачивает журнал в новый снимок индекса
+    void Checkpoint();
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const {
+        return search_server_.FindTopDocuments(std::forward<Args>(args)...);
+    }
+
+    int GetDocumentCount() const;
+    const SearchServer& GetSearchServer() const;
+
+private:
+    std::filesystem::path directory_;
+    uint64_t generation_;
+    SearchServer search_server_;
+    std::unique_ptr<OperationLog> log_;
+
+    static uint64_t FindLastGeneration(const std::filesystem::path& directory);
+    std::filesystem::path GetIndexPath(uint64_t generation) const;
+    std::filesystem::path GetLogPath(uint64_t generation) const;
+    // Загружает снимок текущего поколения (или берёт пустой сервер) и воспроизводит журнал
+    SearchServer Recover(SearchServer empty_server) const;
+    void RemoveStaleFiles() const;
+};
+
+template <typename StringContainer>
+DurableSearchServer::DurableSearchServer(const std::string& directory, const StringContainer& stop_words)
+    : directory_(directory)
+    , generation_(FindLastGeneration(directory_))
+    , search_server_(Recover(SearchServer(stop_words)))
+    , log_(std::make_unique<OperationLog>(GetLogPath(generation_).string())) {
+    RemoveStaleFiles();
+}
@@ -0,0 +1,120 @@
+#include <stdexcept>
+
+#include "forward_index.h"
+
+using namespace std;
+
+void ForwardIndex::AddDocument(std::vector<TermFreq> term_freqs) {
+    delta_.push_back(std::move(term_freqs));
+    CompactIfNeeded();
+}
+
+void ForwardIndex::ClearDocument(DocumentOrdinal ordinal) {
+    if (ordinal >= base_->document_count) {
+        auto& term_freqs = delta_[ordinal - base_->document_count];
+        term_freqs.clear();
+        term_freqs.shrink_to_fit();
+        return;
+    }
+    if (cleared_.empty()) {
+        cleared_.assign(base_->document_count, 0);
+    }
+    if (!cleared_[ordinal]) {
+        cleared_[ordinal] = 1;
+        ++cleared_count_;
+        CompactIfNeeded();
+    }
+}
+
+size_t ForwardIndex::GetDocumentCount() const {
+    return base_->document_count + delta_.size();
+}
+
+bool ForwardIndex::HasTerm(DocumentOrdinal ordinal, TermId term) const {
+    if (ordinal >= base_->document_count) {
+        const auto& term_freqs = delta_[ordinal - base_->document_count];
+        return std::binary_search(term_freqs.begin(), term_freqs.end(), TermFreq{term, 0.0},
+                                  [](const TermFreq& lhs, const TermFreq& rhs) {
+                                      return lhs.term < rhs.term;
+                                  });
+    }
+    return !IsCleared(ordinal)
+           && std::binary_search(base_->terms + base_->offsets[ordinal], base_->terms + base_->offsets[ordinal + 1], term);
+}
+
+void ForwardIndex::Save(IndexFileWriter& writer, const std::vector<DocumentOrdinal>& new_ordinals) const {
+    const SegmentArrays segment = BuildSegment([&new_ordinals](DocumentOrdinal ordinal) {
+        return new_ordinals[ordinal] != NO_ORDINAL;
+    });
+    writer.WriteArray(segment.offsets.data(), segment.offsets.size());
+    writer.WriteArray(segment.terms.data(), segment.terms.size());
+    writer.WriteArray(segment.term_freqs.data(), segment.term_freqs.size());
+}
+
+void ForwardIndex::Load(IndexFileReader& reader, size_t document_count, size_t term_count) {
+    auto segment = std::make_shared<Segment>();
+    segment->document_count = document_count;
+    segment->offsets = reader.ReadArray<uint64_t>(document_count + 1);
+    if (segment->offsets[0] != 0) {
+        throw std::invalid_argument("Invalid index file document terms"s);
+    }
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        if (segment->offsets[ordinal] > segment->offsets[ordinal + 1]) {
+            throw std::invalid_argument("Invalid index file document terms"s);
+        }
+    }
+    const uint64_t term_freq_count = segment->offsets[document_count];
+    segment->terms = reader.ReadArray<TermId>(term_freq_count);
+    segment->term_freqs = reader.ReadArray<double>(term_freq_count);
+    segment->storage = reader.GetStorage();
+    // HasTerm ищет слово двоичным поиском, поэтому слова документа должны возрастать
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        for (uint64_t pos = segment->offsets[ordinal]; pos < segment->offsets[ordinal + 1]; ++pos) {
+            if (segment->terms[pos] >= term_count
+                || (pos > segment->offsets[ordinal] && segment->terms[pos - 1] >= segment->terms[pos])) {
+                throw std::invalid_argument("Invalid index file document terms"s);
+            }
+        }
+    }
+
+    base_ = std::move(segment);
+    std::vector<char>().swap(cleared_);
+    std::vector<std::vector<TermFreq>>().swap(delta_);
+    cleared_count_ = 0;
+}
+
+void ForwardIndex::Renumber(const std::vector<DocumentOrdinal>& new_ordinals) {
+    SetBase(std::make_shared<const SegmentArrays>(BuildSegment([&new_ordinals](DocumentOrdinal ordinal) {
+        return new_ordinals[ordinal] != NO_ORDINAL;
+    })));
+}
+
+bool ForwardIndex::IsCleared(DocumentOrdinal ordinal) const {
+    return !cleared_.empty() && cleared_[ordinal];
+}
+
+void ForwardIndex::CompactIfNeeded() {
+    const size_t changes = delta_.size() + cleared_count_;
+    if (changes >= FORWARD_INDEX_COMPACTION_MIN_DELTA && changes * 2 >= base_->document_count) {
+        Compact();
+    }
+}
+
+void ForwardIndex::Compact() {
+    SetBase(std::make_shared<const SegmentArrays>(BuildSegment([](DocumentOrdinal) {
+        return true;
+    })));
+}
+
+void ForwardIndex::SetBase(std::shared_ptr<const SegmentArrays> arrays) {
+    auto segment = std::make_shared<Segment>();
+    segment->offsets = arrays->offsets.data();
+    segment->terms = arrays->terms.data();
+    segment->term_freqs = arrays->term_freqs.data();
+    segment->document_count = arrays->offsets.size() - 1;
+    segment->storage = std::move(arrays);
+    base_ = std::move(segment);
+    std::vector<char>().swap(cleared_);
+    std::vector<std::vector<TermFreq>>().swap(delta_);
+    cleared_count_ = 0;
+}
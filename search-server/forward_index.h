@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "index_file.h"
+#include "inverted_index.h"
+#include "term_dictionary.h"
+
+// Минимальное число изменённых документов, после которого прямой индекс перестраивается
+constexpr size_t FORWARD_INDEX_COMPACTION_MIN_DELTA = 1024;
+
+// Прямой индекс: слова каждого документа по возрастанию номера слова с частотами.
+// Устроен как InvertedIndex: слова документа лежат в общих массивах базового сегмента,
+// offsets[ordinal]..offsets[ordinal + 1] — диапазон документа. Новые документы копятся
+// в буфере delta_, слова удалённых помечаются в cleared_, и при накоплении изменений
+// базовый сегмент перестраивается целиком. Базовый сегмент неизменяем, копии индекса
+// разделяют его, и он может читаться прямо из отображённого в память файла индекса.
+class ForwardIndex {
+public:
+    // Номер нового документа равен GetDocumentCount()
+    void AddDocument(std::vector<TermFreq> term_freqs);
+    // Убирает слова удалённого документа, номер остаётся занятым
+    void ClearDocument(DocumentOrdinal ordinal);
+
+    // Количество номеров, включая документы без слов
+    size_t GetDocumentCount() const;
+
+    // Вызывает callback(term, term_freq) для слов документа по возрастанию номера слова
+    template <typename Callback>
+    void ForEachTerm(DocumentOrdinal ordinal, Callback callback) const;
+    bool HasTerm(DocumentOrdinal ordinal, TermId term) const;
+
+    // Записывает документы с new_ordinals[ordinal] != NO_ORDINAL, новые номера должны сохранять порядок
+    void Save(IndexFileWriter& writer, const std::vector<DocumentOrdinal>& new_ordinals) const;
+    // Заменяет содержимое индекса document_count документами из файла, массивы не копируются.
+    // Проверяет, что границы документов не убывают, а номера слов документа возрастают
+    // и меньше term_count
+    void Load(IndexFileReader& reader, size_t document_count, size_t term_count);
+
+    // Оставляет документы с new_ordinals[ordinal] != NO_ORDINAL под новыми номерами,
+    // новые номера должны идти подряд в прежнем порядке
+    void Renumber(const std::vector<DocumentOrdinal>& new_ordinals);
+
+private:
+    struct Segment {
+        const uint64_t* offsets = nullptr;
+        const TermId* terms = nullptr;
+        const double* term_freqs = nullptr;
+        size_t document_count = 0;
+
+        // Владелец массивов: векторы, построенные Compact, или отображённый файл
+        std::shared_ptr<const void> storage;
+    };
+
+    struct SegmentArrays {
+        std::vector<uint64_t> offsets;
+        std::vector<TermId> terms;
+        std::vector<double> term_freqs;
+    };
+
+    std::shared_ptr<const Segment> base_ = std::make_shared<Segment>();
+    std::vector<char> cleared_;
+    std::vector<std::vector<TermFreq>> delta_;
+    size_t cleared_count_ = 0;
+
+    bool IsCleared(DocumentOrdinal ordinal) const;
+    void CompactIfNeeded();
+    void Compact();
+    void SetBase(std::shared_ptr<const SegmentArrays> arrays);
+    // Слова документов, для которых keep(ordinal) истинно, в порядке номеров
+    template <typename Keep>
+    SegmentArrays BuildSegment(Keep keep) const;
+};
+
+template <typename Callback>
+void ForwardIndex::ForEachTerm(DocumentOrdinal ordinal, Callback callback) const {
+    if (ordinal >= base_->document_count) {
+        for (const auto [term, term_freq] : delta_[ordinal - base_->document_count]) {
+            callback(term, term_freq);
+        }
+    } else if (!IsCleared(ordinal)) {
+        for (uint64_t pos = base_->offsets[ordinal]; pos < base_->offsets[ordinal + 1]; ++pos) {
+            callback(base_->terms[pos], base_->term_freqs[pos]);
+        }
+    }
+}
+
+template <typename Keep>
+ForwardIndex::SegmentArrays ForwardIndex::BuildSegment(Keep keep) const {
+    const size_t document_count = GetDocumentCount();
+    SegmentArrays segment;
+    segment.offsets.push_back(0);
+    size_t term_freq_count = 0;
+    for (DocumentOrdinal ordinal = 0; ordinal < document_count; ++ordinal) {
+        if (keep(ordinal)) {
+            ForEachTerm(ordinal, [&term_freq_count](TermId, double) {
+                ++term_freq_count;
+            });
+            segment.offsets.push_back(term_freq_count);
+        }
+    }
+    segment.terms.reserve(term_freq_count);
+    segment.term_freqs.reserve(term_freq_count);
+    for (DocumentOrdinal ordinal = 0; ordinal < document_count; ++ordinal) {
+        if (keep(ordinal)) {
+            ForEachTerm(ordinal, [&segment](TermId term, double term_freq) {
+                segment.terms.push_back(term);
+                segment.term_freqs.push_back(term_freq);
+            });
+        }
+    }
+    return segment;
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+
+#include "histogram.h"
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << HISTOGRAM_SUB_BUCKET_BITS;
+constexpr uint64_t MAX_VALUE = (uint64_t{1} << HISTOGRAM_MAX_VALUE_BITS) - 1;
+
+} // namespace
+
+void HistogramSnapshot::Merge(const HistogramSnapshot& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+}
+
+uint64_t HistogramSnapshot::GetPercentile(double percent) const {
+    // count и корзины читаются не одновременно, поэтому порог считается по сумме корзин
+    uint64_t total = 0;
+    for (const uint64_t bucket_count : counts) {
+        total += bucket_count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(percent, 0.0, 100.0) / 100 * total)));
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        accumulated += counts[i];
+        if (accumulated >= rank) {
+            return Histogram::GetBucketUpperBound(i);
+        }
+    }
+    return Histogram::GetBucketUpperBound(counts.size() - 1);
+}
+
+double HistogramSnapshot::GetMean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+}
+
+void Histogram::Record(uint64_t value) {
+    counts_[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Histogram::Reset() {
+    for (auto& bucket_count : counts_) {
+        bucket_count.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::GetSnapshot() const {
+    HistogramSnapshot snapshot;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count = count_.load(std::memory_order_relaxed);
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+size_t Histogram::GetBucketIndex(uint64_t value) {
+    if (value < 2 * SUB_BUCKET_COUNT) {
+        return value;
+    }
+    value = std::min(value, MAX_VALUE);
+    const int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BUCKET_BITS;
+    return (static_cast<size_t>(shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + ((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t Histogram::GetBucketUpperBound(size_t index) {
+    if (index < 2 * SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int shift = static_cast<int>(index >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    const uint64_t top = SUB_BUCKET_COUNT + (index & (SUB_BUCKET_COUNT - 1));
+    return ((top + 1) << shift) - 1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Значения до 2^HISTOGRAM_MAX_VALUE_BITS, большие попадают в последнюю корзину.
+// Каждая степень двойки делится на 2^HISTOGRAM_SUB_BUCKET_BITS корзин, поэтому
+// относительная погрешность не больше 1/32, а значения меньше 64 хранятся точно
+constexpr int HISTOGRAM_SUB_BUCKET_BITS = 5;
+constexpr int HISTOGRAM_MAX_VALUE_BITS = 40;
+constexpr size_t HISTOGRAM_BUCKET_COUNT = (HISTOGRAM_MAX_VALUE_BITS - HISTOGRAM_SUB_BUCKET_BITS + 1) << HISTOGRAM_SUB_BUCKET_BITS;
+
+// Копия счётчиков гистограммы, с которой можно работать без синхронизации
+struct HistogramSnapshot {
+    std::array<uint64_t, HISTOGRAM_BUCKET_COUNT> counts = {};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    void Merge(const HistogramSnapshot& other);
+    // Наименьшая верхняя граница корзины, до которой включительно лежит не меньше
+    // percent процентов значений, 0 для пустой гистограммы
+    uint64_t GetPercentile(double percent) const;
+    double GetMean() const;
+};
+
+// Логарифмическая гистограмма в духе HdrHistogram. Record — несколько атомарных операций
+// без блокировок, его можно вызывать из любых потоков
+class Histogram {
+public:
+    void Record(uint64_t value);
+    void Reset();
+    HistogramSnapshot GetSnapshot() const;
+
+    static size_t GetBucketIndex(uint64_t value);
+    static uint64_t GetBucketUpperBound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKET_COUNT> counts_ = {};
+    std::atomic<uint64_t> count_ = 0;
+    std::atomic<uint64_t> sum_ = 0;
+};
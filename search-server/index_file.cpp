@@ -0,0 +1,184 @@
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "index_file.h"
+
+using namespace std;
+
+namespace {
+
+constexpr size_t INDEX_FILE_ALIGNMENT = 8;
+// Буфер записи сбрасывается на диск частями примерно такого размера
+constexpr size_t INDEX_FILE_FLUSH_SIZE = 1 << 20;
+
+struct IndexFileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+// Размер данных кратен 8 байтам, сумма считается по 64-битным словам
+uint64_t UpdateChecksum(uint64_t checksum, const char* data, size_t size) {
+    for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        checksum = (checksum ^ word) * 0x9E3779B97F4A7C15ull;
+        checksum ^= checksum >> 29;
+    }
+    return checksum;
+}
+
+struct MappedFile {
+    void* data = MAP_FAILED;
+    size_t size = 0;
+
+    ~MappedFile() {
+        if (data != MAP_FAILED) {
+            munmap(data, size);
+        }
+    }
+};
+
+} // namespace
+
+IndexFileWriter::IndexFileWriter(const std::string& path)
+    : output_(path, std::ios::binary | std::ios::trunc) {
+    if (!output_) {
+        throw std::runtime_error("Cannot open index file "s + path);
+    }
+    // Заголовок пишется в Finish, когда известна контрольная сумма
+    const IndexFileHeader header{};
+    output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void IndexFileWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> lengths;
+    lengths.reserve(strings.size());
+    for (const std::string_view str : strings) {
+        lengths.push_back(str.size());
+    }
+    Write<uint64_t>(strings.size());
+    WriteArray(lengths.data(), lengths.size());
+    Align();
+    for (const std::string_view str : strings) {
+        WriteBytes(str.data(), str.size());
+    }
+}
+
+void IndexFileWriter::Finish() {
+    Align();
+    Flush(buffer_.size());
+
+    const IndexFileHeader header{INDEX_FILE_MAGIC, INDEX_FILE_VERSION, 0, payload_size_, checksum_};
+    output_.seekp(0);
+    output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output_.flush();
+    if (!output_) {
+        throw std::runtime_error("Cannot write index file"s);
+    }
+}
+
+void IndexFileWriter::Align() {
+    const size_t size = payload_size_ + buffer_.size();
+    buffer_.append((INDEX_FILE_ALIGNMENT - size % INDEX_FILE_ALIGNMENT) % INDEX_FILE_ALIGNMENT, '\0');
+}
+
+void IndexFileWriter::WriteBytes(const char* data, size_t size) {
+    buffer_.append(data, size);
+    if (buffer_.size() >= INDEX_FILE_FLUSH_SIZE) {
+        Flush(buffer_.size() - buffer_.size() % INDEX_FILE_ALIGNMENT);
+    }
+}
+
+void IndexFileWriter::Flush(size_t size) {
+    checksum_ = UpdateChecksum(checksum_, buffer_.data(), size);
+    output_.write(buffer_.data(), size);
+    payload_size_ += size;
+    buffer_.erase(0, size);
+}
+
+IndexFileReader::IndexFileReader(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open index file "s + path);
+    }
+    struct stat file_stat;
+    auto file = std::make_shared<MappedFile>();
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        file->size = static_cast<size_t>(file_stat.st_size);
+        file->data = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (file->data == MAP_FAILED) {
+        throw std::runtime_error("Cannot map index file "s + path);
+    }
+
+    IndexFileHeader header;
+    if (file->size < sizeof(header)) {
+        throw std::invalid_argument("Index file is truncated"s);
+    }
+    const char* data = static_cast<const char*>(file->data);
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != INDEX_FILE_MAGIC) {
+        throw std::invalid_argument("Not an index file"s);
+    }
+    if (header.version != INDEX_FILE_VERSION) {
+        throw std::invalid_argument("Unsupported index file version "s + std::to_string(header.version));
+    }
+    if (header.payload_size != file->size - sizeof(header) || header.payload_size % INDEX_FILE_ALIGNMENT != 0) {
+        throw std::invalid_argument("Index file is truncated"s);
+    }
+    position_ = data + sizeof(header);
+    end_ = position_ + header.payload_size;
+    if (UpdateChecksum(0, position_, header.payload_size) != header.checksum) {
+        throw std::invalid_argument("Index file checksum mismatch"s);
+    }
+    storage_ = std::move(file);
+}
+
+std::vector<std::string_view> IndexFileReader::ReadStrings() {
+    const auto count = Read<uint64_t>();
+    const uint64_t* lengths = ReadArray<uint64_t>(count);
+    // Строки не длиннее остатка файла, так что сумма длин не переполняется
+    const uint64_t remaining = static_cast<uint64_t>(end_ - position_);
+    uint64_t total_length = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (lengths[i] > remaining - total_length) {
+            throw std::invalid_argument("Index file is truncated"s);
+        }
+        total_length += lengths[i];
+    }
+    const char* chars = ReadArray<char>(total_length);
+
+    std::vector<std::string_view> strings;
+    strings.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        strings.emplace_back(chars, lengths[i]);
+        chars += lengths[i];
+    }
+    return strings;
+}
+
+const std::shared_ptr<const void>& IndexFileReader::GetStorage() const {
+    return storage_;
+}
+
+const char* IndexFileReader::ReadBytes(size_t count, size_t element_size) {
+    const size_t offset = reinterpret_cast<uintptr_t>(position_) % INDEX_FILE_ALIGNMENT;
+    if (offset != 0) {
+        position_ += INDEX_FILE_ALIGNMENT - offset;
+    }
+    if (position_ > end_ || count > static_cast<size_t>(end_ - position_) / element_size) {
+        throw std::invalid_argument("Index file is truncated"s);
+    }
+    const char* data = position_;
+    position_ += count * element_size;
+    return data;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Бинарный файл индекса: заголовок (сигнатура, версия, размер и контрольная сумма данных)
+// и данные. Каждое значение и каждый массив выровнены по 8 байт, поэтому при чтении
+// массивы используются прямо из отображённого в память файла без копирования.
+constexpr uint64_t INDEX_FILE_MAGIC = 0x5844495352565253; // "SRVRSIDX"
+constexpr uint32_t INDEX_FILE_VERSION = 1;
+
+class IndexFileWriter {
+public:
+    explicit IndexFileWriter(const std::string& path);
+
+    template <typename T>
+    void Write(const T& value) {
+        WriteArray(&value, 1);
+    }
+
+    template <typename T>
+    void WriteArray(const T* data, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Align();
+        WriteBytes(reinterpret_cast<const char*>(data), count * sizeof(T));
+    }
+
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+    // Дописывает буфер и заголовок. Без вызова Finish файл остаётся некорректным
+    void Finish();
+
+private:
+    std::ofstream output_;
+    std::string buffer_;
+    uint64_t payload_size_ = 0;
+    uint64_t checksum_ = 0;
+
+    void Align();
+    void WriteBytes(const char* data, size_t size);
+    void Flush(size_t size);
+};
+
+// Отображает файл индекса в память и проверяет заголовок и контрольную сумму.
+// Указатели, возвращаемые ReadArray, действительны, пока жив GetStorage().
+class IndexFileReader {
+public:
+    explicit IndexFileReader(const std::string& path);
+
+    template <typename T>
+    T Read() {
+        return *ReadArray<T>(1);
+    }
+
+    template <typename T>
+    const T* ReadArray(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return reinterpret_cast<const T*>(ReadBytes(count, sizeof(T)));
+    }
+
+    std::vector<std::string_view> ReadStrings();
+
+    const std::shared_ptr<const void>& GetStorage() const;
+
+private:
+    std::shared_ptr<const void> storage_;
+    const char* position_ = nullptr;
+    const char* end_ = nullptr;
+
+    const char* ReadBytes(size_t count, size_t element_size);
+};
@@ -0,0 +1,29 @@
+#include "inverse_document_freq_cache.h"
+
+using namespace std;
+
+void InverseDocumentFreqCache::Invalidate(size_t term_count) {
+    ++epoch_;
+    while (entries_.size() < term_count) {
+        entries_.emplace_back();
+    }
+}
+
+InverseDocumentFreqCacheStats InverseDocumentFreqCache::GetStats() const {
+    InverseDocumentFreqCacheStats stats;
+    for (const Counters& counters : counters_) {
+        stats.hits += counters.hits.load(std::memory_order_relaxed);
+        stats.misses += counters.misses.load(std::memory_order_relaxed);
+    }
+    stats.refresh_count = refresh_count_;
+    stats.refreshed_terms = refreshed_terms_;
+    stats.refresh_duration = refresh_duration_;
+    return stats;
+}
+
+InverseDocumentFreqCache::Counters& InverseDocumentFreqCache::GetThreadCounters() const {
+    // Номер ячейки выдаётся потоку один раз и общий для всех кэшей
+    static std::atomic<size_t> next_slot{0};
+    thread_local const size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % INVERSE_DOCUMENT_FREQ_COUNTER_SLOTS;
+    return counters_[slot];
+}
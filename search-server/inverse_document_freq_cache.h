@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+#include "term_dictionary.h"
+
+// Ячейки счётчиков попаданий: потоки пишут каждый в свою ячейку, пока их не больше
+constexpr size_t INVERSE_DOCUMENT_FREQ_COUNTER_SLOTS = 64;
+
+struct InverseDocumentFreqCacheStats {
+    // Поиски IDF при обработке запросов
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Пересчёты всей таблицы после пакетного добавления
+    uint64_t refresh_count = 0;
+    uint64_t refreshed_terms = 0;
+    std::chrono::nanoseconds refresh_duration{0};
+};
+
+// IDF слов, вычисленные для текущей эпохи корпуса. Любое изменение корпуса начинает
+// новую эпоху, и значения прошлых эпох становятся устаревшими. Устаревшее значение
+// пересчитывается при первом запросе к нему, после пакетного добавления таблица
+// пересчитывается целиком.
+// Get можно вызывать из нескольких потоков одновременно: в пределах эпохи все потоки
+// вычисляют одинаковые значения, поэтому запись значения может гоняться только сама с собой.
+class InverseDocumentFreqCache {
+public:
+    InverseDocumentFreqCache() = default;
+    // Копия начинает с устаревшими значениями и нулевой статистикой
+    InverseDocumentFreqCache(const InverseDocumentFreqCache& other)
+        : entries_(other.entries_.size()) {
+    }
+    InverseDocumentFreqCache& operator=(const InverseDocumentFreqCache&) = delete;
+
+    // Начинает новую эпоху для словаря из term_count слов
+    void Invalidate(size_t term_count);
+
+    template <typename Compute>
+    double Get(TermId term, Compute compute) const;
+
+    template <typename ExecutionPolicy, typename Compute>
+    void Refresh(const ExecutionPolicy& policy, Compute compute);
+
+    InverseDocumentFreqCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        mutable std::atomic<uint64_t> epoch{0};
+        mutable std::atomic<double> value{0.0};
+    };
+
+    // Общий счётчик на горячем пути гонял бы кэш-линию между потоками поиска,
+    // поэтому у каждого потока своя линия, а GetStats складывает все
+    struct alignas(64) Counters {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+    };
+
+    // deque не перемещает элементы при росте, атомики перемещать нельзя
+    std::deque<Entry> entries_;
+    uint64_t epoch_ = 1;
+
+    mutable std::array<Counters, INVERSE_DOCUMENT_FREQ_COUNTER_SLOTS> counters_;
+    uint64_t refresh_count_ = 0;
+    uint64_t refreshed_terms_ = 0;
+    std::chrono::nanoseconds refresh_duration_{0};
+
+    Counters& GetThreadCounters() const;
+};
+
+template <typename Compute>
+double InverseDocumentFreqCache::Get(TermId term, Compute compute) const {
+    if (term < entries_.size()) {
+        const Entry& entry = entries_[term];
+        if (entry.epoch.load(std::memory_order_acquire) == epoch_) {
+            GetThreadCounters().hits.fetch_add(1, std::memory_order_relaxed);
+            return entry.value.load(std::memory_order_relaxed);
+        }
+    }
+    GetThreadCounters().misses.fetch_add(1, std::memory_order_relaxed);
+    const double value = compute(term);
+    if (term < entries_.size()) {
+        entries_[term].value.store(value, std::memory_order_relaxed);
+        entries_[term].epoch.store(epoch_, std::memory_order_release);
+    }
+    return value;
+}
+
+template <typename ExecutionPolicy, typename Compute>
+void InverseDocumentFreqCache::Refresh(const ExecutionPolicy& policy, Compute compute) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<TermId> terms(entries_.size());
+    std::iota(terms.begin(), terms.end(), 0);
+    std::for_each(policy, terms.begin(), terms.end(), [this, &compute](TermId term) {
+        entries_[term].value.store(compute(term), std::memory_order_relaxed);
+        entries_[term].epoch.store(epoch_, std::memory_order_relaxed);
+    });
+    ++refresh_count_;
+    refreshed_terms_ += terms.size();
+    refresh_duration_ += std::chrono::steady_clock::now() - start;
+}
@@ -0,0 +1,329 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "inverted_index.h"
+
+using namespace std;
+
+void InvertedIndex::AddPosting(TermId term, DocumentOrdinal ordinal, double term_freq) {
+    ReserveTerms(term + 1);
+    delta_[term].push_back({ordinal, term_freq});
+    max_term_freqs_[term] = std::max(max_term_freqs_[term], term_freq);
+    ++document_freqs_[term];
+    ++delta_size_;
+}
+
+size_t InvertedIndex::GetDocumentFreq(TermId term) const {
+    return document_freqs_.at(term);
+}
+
+double InvertedIndex::GetMaxTermFreq(TermId term) const {
+    return max_term_freqs_.at(term);
+}
+
+void InvertedIndex::SetEncoding(PostingEncoding encoding) {
+    encoding_ = encoding;
+    Compact();
+}
+
+PostingEncoding InvertedIndex::GetEncoding() const {
+    return encoding_;
+}
+
+IndexMemoryUsage InvertedIndex::GetMemoryUsage() const {
+    IndexMemoryUsage usage;
+    usage.posting_count = base_->posting_count - removed_count_ + delta_size_;
+    usage.bytes = (base_->term_count + 1) * sizeof(uint32_t);
+    if (base_->is_compressed) {
+        usage.bytes += (base_->term_count + 1) * sizeof(uint32_t)
+                       + base_->block_count * (sizeof(DocumentOrdinal) + sizeof(uint64_t))
+                       + base_->block_data_size
+                       + base_->posting_count * sizeof(uint16_t)
+                       + base_->codebook_size * sizeof(double);
+    } else {
+        usage.bytes += base_->posting_count * (sizeof(DocumentOrdinal) + sizeof(double));
+    }
+    usage.bytes += removed_.capacity() * sizeof(uint64_t)
+                   + delta_.capacity() * sizeof(std::vector<Posting>)
+                   + document_freqs_.capacity() * sizeof(uint32_t)
+                   + max_term_freqs_.capacity() * sizeof(double);
+    for (const auto& postings : delta_) {
+        usage.bytes += postings.capacity() * sizeof(Posting);
+    }
+    return usage;
+}
+
+InvertedIndex::PostingCursor InvertedIndex::GetPostings(TermId term) const {
+    PostingCursor cursor;
+    cursor.segment_ = base_.get();
+    cursor.term_ = term;
+    cursor.removed_ = removed_.empty() ? nullptr : removed_.data();
+    if (term < base_->term_count) {
+        cursor.base_pos_ = base_->offsets[term];
+        cursor.base_end_ = base_->offsets[term + 1];
+    }
+    if (base_->is_compressed) {
+        if (cursor.base_pos_ != cursor.base_end_) {
+            cursor.decoded_ = std::make_unique<PostingCursor::DecodedBlock>();
+            cursor.LoadBlock(base_->term_blocks[term]);
+        }
+    } else {
+        cursor.block_end_ = cursor.base_end_;
+        cursor.block_ordinals_ = base_->ordinals;
+        cursor.block_term_freqs_ = base_->term_freqs;
+    }
+    cursor.delta_pos_ = delta_[term].data();
+    cursor.delta_end_ = delta_[term].data() + delta_[term].size();
+    cursor.SkipRemoved();
+    return cursor;
+}
+
+void InvertedIndex::PostingCursor::Next() {
+    if (base_pos_ != base_end_) {
+        Advance();
+        SkipRemoved();
+    } else {
+        ++delta_pos_;
+    }
+}
+
+void InvertedIndex::PostingCursor::SkipTo(DocumentOrdinal ordinal) {
+    if (base_pos_ != base_end_) {
+        if (segment_->is_compressed && segment_->block_last_ordinals[block_] < ordinal) {
+            // Нужный постинг лежит в одном из следующих блоков слова, ищем его по последним номерам
+            const auto first = segment_->block_last_ordinals + block_ + 1;
+            const auto last = segment_->block_last_ordinals + segment_->term_blocks[term_ + 1];
+            const size_t block = std::lower_bound(first, last, ordinal) - segment_->block_last_ordinals;
+            if (block == segment_->term_blocks[term_ + 1]) {
+                base_pos_ = base_end_;
+            } else {
+                LoadBlock(block);
+                base_pos_ = block_first_;
+            }
+        }
+        if (base_pos_ != base_end_) {
+            const auto first = block_ordinals_ + (base_pos_ - block_first_);
+            const auto last = block_ordinals_ + (block_end_ - block_first_);
+            base_pos_ = block_first_ + (std::lower_bound(first, last, ordinal) - block_ordinals_);
+            SkipRemoved();
+            if (base_pos_ != base_end_) {
+                return;
+            }
+        }
+    }
+    delta_pos_ = std::lower_bound(delta_pos_, delta_end_, ordinal,
+                                  [](const Posting& posting, DocumentOrdinal value) {
+                                      return posting.ordinal < value;
+                                  });
+}
+
+void InvertedIndex::PostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    block_first_ = segment_->GetBlockFirst(term_, block);
+    block_end_ = segment_->GetBlockEnd(term_, block);
+    segment_->DecodeBlock(term_, block, decoded_->ordinals.data(), decoded_->term_freqs.data());
+    block_ordinals_ = decoded_->ordinals.data();
+    block_term_freqs_ = decoded_->term_freqs.data();
+}
+
+void InvertedIndex::PostingCursor::Advance() {
+    ++base_pos_;
+    if (base_pos_ == block_end_ && base_pos_ != base_end_) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void InvertedIndex::PostingCursor::SkipRemoved() {
+    while (base_pos_ != base_end_ && IsRemoved(removed_, base_pos_)) {
+        Advance();
+    }
+}
+
+void InvertedIndex::Segment::DecodeBlock(TermId term, size_t block, DocumentOrdinal* ordinals, double* term_freqs) const {
+    const DocumentOrdinal previous = block == term_blocks[term] ? 0 : block_last_ordinals[block - 1];
+    const size_t first = GetBlockFirst(term, block);
+    const size_t count = GetBlockEnd(term, block) - first;
+    DecodeOrdinals(block_data + block_offsets[block], count, previous, ordinals);
+    if (term_freqs) {
+        for (size_t i = 0; i < count; ++i) {
+            term_freqs[i] = term_freq_codebook[term_freq_codes[first + i]];
+        }
+    }
+}
+
+size_t InvertedIndex::Segment::FindPosting(TermId term, DocumentOrdinal ordinal) const {
+    if (term >= term_count) {
+        return posting_count;
+    }
+    if (!is_compressed) {
+        const auto first = ordinals + offsets[term];
+        const auto last = ordinals + offsets[term + 1];
+        const auto it = std::lower_bound(first, last, ordinal);
+        return it != last && *it == ordinal ? it - ordinals : posting_count;
+    }
+
+    const auto first_block = block_last_ordinals + term_blocks[term];
+    const auto last_block = block_last_ordinals + term_blocks[term + 1];
+    const size_t block = std::lower_bound(first_block, last_block, ordinal) - block_last_ordinals;
+    if (block == term_blocks[term + 1]) {
+        return posting_count;
+    }
+    std::array<DocumentOrdinal, POSTING_BLOCK_SIZE> block_ordinals;
+    DecodeBlock(term, block, block_ordinals.data(), nullptr);
+    const size_t count = GetBlockEnd(term, block) - GetBlockFirst(term, block);
+    const auto it = std::lower_bound(block_ordinals.begin(), block_ordinals.begin() + count, ordinal);
+    return it != block_ordinals.begin() + count && *it == ordinal
+           ? GetBlockFirst(term, block) + (it - block_ordinals.begin())
+           : posting_count;
+}
+
+void InvertedIndex::Save(IndexFileWriter& writer, const std::vector<DocumentOrdinal>& new_ordinals) const {
+    const size_t term_count = delta_.size();
+    SegmentArrays segment;
+    segment.offsets.resize(term_count + 1, 0);
+    std::inclusive_scan(document_freqs_.begin(), document_freqs_.end(), segment.offsets.begin() + 1,
+                        std::plus<>(), uint32_t{0});
+    segment.ordinals.reserve(segment.offsets.back());
+    segment.term_freqs.reserve(segment.offsets.back());
+    std::vector<double> max_term_freqs(term_count, 0.0);
+    for (TermId term = 0; term < term_count; ++term) {
+        ForEachPosting(term, [&](DocumentOrdinal ordinal, double term_freq) {
+            segment.ordinals.push_back(new_ordinals[ordinal]);
+            segment.term_freqs.push_back(term_freq);
+            max_term_freqs[term] = std::max(max_term_freqs[term], term_freq);
+        });
+    }
+
+    writer.Write<uint64_t>(term_count);
+    writer.Write<uint64_t>(segment.ordinals.size());
+    writer.WriteArray(segment.offsets.data(), segment.offsets.size());
+    writer.WriteArray(segment.ordinals.data(), segment.ordinals.size());
+    writer.WriteArray(segment.term_freqs.data(), segment.term_freqs.size());
+    writer.WriteArray(max_term_freqs.data(), max_term_freqs.size());
+}
+
+void InvertedIndex::Load(IndexFileReader& reader, size_t term_count, size_t document_count) {
+    auto segment = std::make_shared<Segment>();
+    segment->term_count = reader.Read<uint64_t>();
+    if (segment->term_count != term_count) {
+        throw std::invalid_argument("Invalid index file postings"s);
+    }
+    segment->posting_count = reader.Read<uint64_t>();
+    segment->offsets = reader.ReadArray<uint32_t>(segment->term_count + 1);
+    segment->ordinals = reader.ReadArray<DocumentOrdinal>(segment->posting_count);
+    segment->term_freqs = reader.ReadArray<double>(segment->posting_count);
+    const double* max_term_freqs = reader.ReadArray<double>(segment->term_count);
+    segment->storage = reader.GetStorage();
+
+    if (segment->offsets[0] != 0 || segment->offsets[segment->term_count] != segment->posting_count) {
+        throw std::invalid_argument("Invalid index file postings"s);
+    }
+    document_freqs_.resize(segment->term_count);
+    for (TermId term = 0; term < segment->term_count; ++term) {
+        if (segment->offsets[term] > segment->offsets[term + 1]) {
+            throw std::invalid_argument("Invalid index file postings"s);
+        }
+        document_freqs_[term] = segment->offsets[term + 1] - segment->offsets[term];
+        // Максимум TF — верхняя граница вклада слова при отсечении MaxScore
+        if (!std::isfinite(max_term_freqs[term]) || max_term_freqs[term] < 0) {
+            throw std::invalid_argument("Invalid index file postings"s);
+        }
+        for (size_t pos = segment->offsets[term]; pos < segment->offsets[term + 1]; ++pos) {
+            if (segment->ordinals[pos] >= document_count
+                || (pos > segment->offsets[term] && segment->ordinals[pos - 1] >= segment->ordinals[pos])
+                || !(segment->term_freqs[pos] >= 0 && segment->term_freqs[pos] <= max_term_freqs[term])) {
+                throw std::invalid_argument("Invalid index file postings"s);
+            }
+        }
+    }
+    max_term_freqs_.assign(max_term_freqs, max_term_freqs + segment->term_count);
+    delta_.assign(segment->term_count, {});
+    std::vector<uint64_t>().swap(removed_);
+    base_ = std::move(segment);
+    delta_size_ = 0;
+    removed_count_ = 0;
+}
+
+void InvertedIndex::CompactIfNeeded() {
+    CompactIfNeeded(std::execution::seq);
+}
+
+void InvertedIndex::Compact() {
+    Compact(std::execution::seq);
+}
+
+bool InvertedIndex::IsCompactionNeeded() const {
+    const size_t changes = delta_size_ + removed_count_;
+    return changes >= INDEX_COMPACTION_MIN_DELTA
+           && changes * 2 >= base_->posting_count;
+}
+
+void InvertedIndex::ReserveTerms(size_t term_count) {
+    if (term_count > delta_.size()) {
+        delta_.resize(term_count);
+        document_freqs_.resize(term_count, 0);
+        max_term_freqs_.resize(term_count, 0.0);
+    }
+}
+
+void InvertedIndex::SetBase(std::shared_ptr<const SegmentArrays> arrays) {
+    auto segment = std::make_shared<Segment>();
+    segment->offsets = arrays->offsets.data();
+    segment->ordinals = arrays->ordinals.data();
+    segment->term_freqs = arrays->term_freqs.data();
+    segment->term_count = arrays->offsets.size() - 1;
+    segment->posting_count = arrays->is_compressed ? arrays->term_freq_codes.size() : arrays->ordinals.size();
+    if (arrays->is_compressed) {
+        segment->is_compressed = true;
+        segment->term_blocks = arrays->term_blocks.data();
+        segment->block_last_ordinals = arrays->block_last_ordinals.data();
+        segment->block_offsets = arrays->block_offsets.data();
+        segment->block_data = arrays->block_data.data();
+        segment->term_freq_codes = arrays->term_freq_codes.data();
+        segment->term_freq_codebook = arrays->term_freq_codebook.data();
+        segment->block_count = arrays->block_last_ordinals.size();
+        segment->block_data_size = arrays->block_data.size();
+        segment->codebook_size = arrays->term_freq_codebook.size();
+    }
+    segment->storage = std::move(arrays);
+
+    std::vector<uint64_t>().swap(removed_);
+    base_ = std::move(segment);
+    delta_size_ = 0;
+    removed_count_ = 0;
+}
+
+InvertedIndex::RemoveResult InvertedIndex::RemovePosting(TermId term, DocumentOrdinal ordinal) {
+    auto& postings = delta_[term];
+    auto it = std::lower_bound(postings.begin(), postings.end(), ordinal,
+                               [](const Posting& posting, DocumentOrdinal value) {
+                                   return posting.ordinal < value;
+                               });
+    if (it != postings.end() && it->ordinal == ordinal) {
+        postings.erase(it);
+        --document_freqs_[term];
+        return RemoveResult::FROM_DELTA;
+    }
+
+    const size_t pos = base_->FindPosting(term, ordinal);
+    if (pos == base_->posting_count) {
+        return RemoveResult::NOT_FOUND;
+    }
+    // Слова документа удаляются параллельно, и их постинги могут делить слово пометок
+    const uint64_t bit = uint64_t{1} << (pos % 64);
+    if (__atomic_fetch_or(&removed_[pos / 64], bit, __ATOMIC_RELAXED) & bit) {
+        return RemoveResult::NOT_FOUND;
+    }
+    --document_freqs_[term];
+    return RemoveResult::FROM_BASE;
+}
+
+uint16_t InvertedIndex::EncodeTermFreq(const std::vector<double>& codebook, double term_freq) {
+    // Ближайшее значение таблицы: следующее за ним не меньше term_freq, предыдущее меньше
+    size_t code = std::lower_bound(codebook.begin(), codebook.end(), term_freq) - codebook.begin();
+    if (code == codebook.size()
+        || (code > 0 && term_freq - codebook[code - 1] < codebook[code] - term_freq)) {
+        --code;
+    }
+    return static_cast<uint16_t>(code);
+}
@@ -0,0 +1,498 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "index_file.h"
+#include "posting_codec.h"
+#include "term_dictionary.h"
+
+// Внутренний плотный номер документа, выдаётся по возрастанию при добавлении
+using DocumentOrdinal = uint32_t;
+
+// Номер удалённого документа в таблице перенумерации
+constexpr DocumentOrdinal NO_ORDINAL = std::numeric_limits<DocumentOrdinal>::max();
+
+// Частота слова в документе
+struct TermFreq {
+    TermId term;
+    double freq;
+};
+
+// Минимальный размер буфера изменений, после которого индекс перестраивается
+constexpr size_t INDEX_COMPACTION_MIN_DELTA = 4096;
+
+// Формат базового сегмента. PLAIN хранит номер и частоту каждого постинга как есть (12 байт).
+// COMPRESSED хранит номера разностями блоками по POSTING_BLOCK_SIZE (posting_codec.h),
+// а частоты — 16-битными номерами значений в таблице частот сегмента. Пока различных
+// частот не больше 65536, таблица точная, иначе частоты округляются до ближайшего
+// из 65536 значений в логарифмической шкале (относительная ошибка порядка 1e-4).
+enum class PostingEncoding {
+    PLAIN,
+    COMPRESSED,
+};
+
+struct IndexMemoryUsage {
+    size_t posting_count = 0;
+    size_t bytes = 0;
+};
+
+// Инвертированный индекс в формате CSR: постинги всех слов лежат в общих
+// отсортированных массивах, offsets[term]..offsets[term + 1] — диапазон слова.
+// Новые постинги копятся в буфере delta_, удалённые помечаются в removed_,
+// и при накоплении изменений базовый сегмент перестраивается целиком.
+// Базовый сегмент может читаться прямо из отображённого в память файла индекса.
+class InvertedIndex {
+    struct Segment;
+
+public:
+    struct Posting {
+        DocumentOrdinal ordinal;
+        double term_freq;
+    };
+
+    // Номера документов должны поступать по возрастанию
+    void AddPosting(TermId term, DocumentOrdinal ordinal, double term_freq);
+
+    // Добавляет пакет документов с номерами first_ordinal, first_ordinal + 1, ...
+    // Слова документа должны быть уникальны. Пакет делится на части, каждая часть
+    // считает свои постинги по словам, после чего части пишут их в непересекающиеся
+    // места буферов слов, сохраняя порядок номеров.
+    template <typename ExecutionPolicy>
+    void AddDocuments(const ExecutionPolicy& policy, DocumentOrdinal first_ordinal,
+                      const std::vector<std::vector<TermFreq>>& documents);
+
+    template <typename ExecutionPolicy>
+    void RemovePostings(const ExecutionPolicy& policy, DocumentOrdinal ordinal, const std::vector<TermId>& terms);
+
+    // Количество документов, содержащих слово
+    size_t GetDocumentFreq(TermId term) const;
+
+    // Верхняя оценка term_freq среди постингов слова, после удалений может быть завышена
+    double GetMaxTermFreq(TermId term) const;
+
+    // Меняет формат базового сегмента и сразу перестраивает его
+    void SetEncoding(PostingEncoding encoding);
+    PostingEncoding GetEncoding() const;
+
+    // Живые постинги и память под них, включая буфер изменений и пометки удаления
+    IndexMemoryUsage GetMemoryUsage() const;
+
+    // Обходит постинги слова в порядке возрастания номера документа.
+    // Сжатый сегмент декодируется по блоку во время обхода
+    template <typename Callback>
+    void ForEachPosting(TermId term, Callback callback) const;
+
+    // Курсор по постингам одного слова с возможностью перескока вперёд
+    class PostingCursor {
+    public:
+        bool IsEnd() const {
+            return base_pos_ == base_end_ && delta_pos_ == delta_end_;
+        }
+
+        DocumentOrdinal GetOrdinal() const {
+            return base_pos_ != base_end_ ? block_ordinals_[base_pos_ - block_first_] : delta_pos_->ordinal;
+        }
+
+        double GetTermFreq() const {
+            return base_pos_ != base_end_ ? block_term_freqs_[base_pos_ - block_first_] : delta_pos_->term_freq;
+        }
+
+        void Next();
+
+        // Переходит к первому постингу с номером не меньше ordinal
+        void SkipTo(DocumentOrdinal ordinal);
+
+    private:
+        friend class InvertedIndex;
+
+        struct DecodedBlock {
+            std::array<DocumentOrdinal, POSTING_BLOCK_SIZE> ordinals;
+            std::array<double, POSTING_BLOCK_SIZE> term_freqs;
+        };
+
+        const Segment* segment_ = nullptr;
+        TermId term_ = 0;
+        const uint64_t* removed_ = nullptr;
+        size_t base_pos_ = 0;
+        size_t base_end_ = 0;
+        // Текущий блок базового сегмента занимает позиции [block_first_, block_end_).
+        // В несжатом сегменте блок один на всё слово и указывает прямо в массивы сегмента
+        size_t block_ = 0;
+        size_t block_first_ = 0;
+        size_t block_end_ = 0;
+        const DocumentOrdinal* block_ordinals_ = nullptr;
+        const double* block_term_freqs_ = nullptr;
+        std::unique_ptr<DecodedBlock> decoded_;
+        const Posting* delta_pos_ = nullptr;
+        const Posting* delta_end_ = nullptr;
+
+        void LoadBlock(size_t block);
+        void Advance();
+        void SkipRemoved();
+    };
+
+    PostingCursor GetPostings(TermId term) const;
+
+    // Записывает индекс в виде одного базового сегмента без удалённых постингов,
+    // номер документа ordinal записывается как new_ordinals[ordinal]
+    void Save(IndexFileWriter& writer, const std::vector<DocumentOrdinal>& new_ordinals) const;
+    // Заменяет содержимое индекса сегментом из файла. Массивы постингов не копируются.
+    // Проверяет, что в сегменте term_count слов, а номера документов каждого слова
+    // возрастают и меньше document_count
+    void Load(IndexFileReader& reader, size_t term_count, size_t document_count);
+
+    void CompactIfNeeded();
+    void Compact();
+    template <typename ExecutionPolicy>
+    void CompactIfNeeded(const ExecutionPolicy& policy);
+    // Перестраивает базовый сегмент, слова обрабатываются независимо друг от друга
+    template <typename ExecutionPolicy>
+    void Compact(const ExecutionPolicy& policy);
+    // Перестраивает базовый сегмент, заменяя номер документа ordinal на new_ordinals[ordinal].
+    // Новые номера должны сохранять порядок, постингов удалённых документов в индексе уже нет
+    template <typename ExecutionPolicy>
+    void Renumber(const ExecutionPolicy& policy, const std::vector<DocumentOrdinal>& new_ordinals);
+
+private:
+    struct Segment {
+        const uint32_t* offsets = nullptr;
+        const DocumentOrdinal* ordinals = nullptr;
+        const double* term_freqs = nullptr;
+        size_t term_count = 0;
+        size_t posting_count = 0;
+
+        // Сжатый сегмент: блоки слова — [term_blocks[term], term_blocks[term + 1]),
+        // для каждого блока известны последний номер (для перескоков) и смещение в block_data
+        bool is_compressed = false;
+        const uint32_t* term_blocks = nullptr;
+        const DocumentOrdinal* block_last_ordinals = nullptr;
+        const uint64_t* block_offsets = nullptr;
+        const uint8_t* block_data = nullptr;
+        const uint16_t* term_freq_codes = nullptr;
+        const double* term_freq_codebook = nullptr;
+        size_t block_count = 0;
+        size_t block_data_size = 0;
+        size_t codebook_size = 0;
+
+        // Владелец массивов: векторы, построенные Compact, или отображённый файл
+        std::shared_ptr<const void> storage;
+
+        size_t GetBlockFirst(TermId term, size_t block) const {
+            return offsets[term] + (block - term_blocks[term]) * POSTING_BLOCK_SIZE;
+        }
+
+        size_t GetBlockEnd(TermId term, size_t block) const {
+            return std::min<size_t>(GetBlockFirst(term, block) + POSTING_BLOCK_SIZE, offsets[term + 1]);
+        }
+
+        // Декодирует блок сжатого сегмента, term_freqs может быть nullptr
+        void DecodeBlock(TermId term, size_t block, DocumentOrdinal* ordinals, double* term_freqs) const;
+        // Позиция постинга (term, ordinal) в сегменте или posting_count, если его нет
+        size_t FindPosting(TermId term, DocumentOrdinal ordinal) const;
+    };
+
+    struct SegmentArrays {
+        std::vector<uint32_t> offsets;
+        std::vector<DocumentOrdinal> ordinals;
+        std::vector<double> term_freqs;
+
+        bool is_compressed = false;
+        std::vector<uint32_t> term_blocks;
+        std::vector<DocumentOrdinal> block_last_ordinals;
+        std::vector<uint64_t> block_offsets;
+        std::vector<uint8_t> block_data;
+        std::vector<uint16_t> term_freq_codes;
+        std::vector<double> term_freq_codebook;
+    };
+
+    // Базовый сегмент неизменяем, поэтому копии индекса разделяют его
+    std::shared_ptr<const Segment> base_ = std::make_shared<Segment>();
+    // Пометки удаления постингов базового сегмента, по биту на постинг
+    std::vector<uint64_t> removed_;
+    std::vector<std::vector<Posting>> delta_;
+    std::vector<uint32_t> document_freqs_;
+    std::vector<double> max_term_freqs_;
+    size_t delta_size_ = 0;
+    size_t removed_count_ = 0;
+    PostingEncoding encoding_ = PostingEncoding::PLAIN;
+
+    enum class RemoveResult {
+        NOT_FOUND,
+        FROM_DELTA,
+        FROM_BASE,
+    };
+
+    RemoveResult RemovePosting(TermId term, DocumentOrdinal ordinal);
+
+    void ReserveTerms(size_t term_count);
+    void SetBase(std::shared_ptr<const SegmentArrays> arrays);
+    // Строит новый базовый сегмент из живых постингов, номер документа ordinal
+    // становится map_ordinal(ordinal)
+    template <typename ExecutionPolicy, typename MapOrdinal>
+    void Rebuild(const ExecutionPolicy& policy, MapOrdinal map_ordinal);
+    // Переводит построенный несжатый сегмент в сжатый формат
+    template <typename ExecutionPolicy>
+    void EncodeSegment(const ExecutionPolicy& policy, SegmentArrays& segment);
+    static uint16_t EncodeTermFreq(const std::vector<double>& codebook, double term_freq);
+    bool IsCompactionNeeded() const;
+
+    static bool IsRemoved(const uint64_t* removed, size_t pos) {
+        return removed && (removed[pos / 64] >> (pos % 64) & 1);
+    }
+};
+
+// Количество документов в одной части пакета AddDocuments
+constexpr size_t INDEX_BATCH_CHUNK_SIZE = 1024;
+
+template <typename ExecutionPolicy>
+void InvertedIndex::AddDocuments(const ExecutionPolicy& policy, DocumentOrdinal first_ordinal,
+                                 const std::vector<std::vector<TermFreq>>& documents) {
+    size_t term_count = 0;
+    for (const auto& document : documents) {
+        for (const auto [term, _] : document) {
+            term_count = std::max<size_t>(term_count, term + 1);
+        }
+    }
+    ReserveTerms(term_count);
+    term_count = delta_.size();
+
+    const size_t chunk_count = (documents.size() + INDEX_BATCH_CHUNK_SIZE - 1) / INDEX_BATCH_CHUNK_SIZE;
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    std::vector<TermId> terms(term_count);
+    std::iota(terms.begin(), terms.end(), 0);
+
+    // Сначала каждая часть считает свои постинги по словам...
+    std::vector<std::vector<uint32_t>> positions(chunk_count);
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        positions[chunk].assign(term_count, 0);
+        const size_t last = std::min(documents.size(), (chunk + 1) * INDEX_BATCH_CHUNK_SIZE);
+        for (size_t i = chunk * INDEX_BATCH_CHUNK_SIZE; i < last; ++i) {
+            for (const auto [term, _] : documents[i]) {
+                ++positions[chunk][term];
+            }
+        }
+    });
+
+    // ...затем для каждого слова счётчики частей превращаются в позиции записи
+    std::vector<size_t> old_sizes(term_count);
+    std::for_each(policy, terms.begin(), terms.end(), [&](TermId term) {
+        size_t position = old_sizes[term] = delta_[term].size();
+        for (auto& chunk_positions : positions) {
+            const uint32_t count = chunk_positions[term];
+            chunk_positions[term] = static_cast<uint32_t>(position);
+            position += count;
+        }
+        document_freqs_[term] += static_cast<uint32_t>(position - old_sizes[term]);
+        delta_[term].resize(position);
+    });
+
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        const size_t last = std::min(documents.size(), (chunk + 1) * INDEX_BATCH_CHUNK_SIZE);
+        for (size_t i = chunk * INDEX_BATCH_CHUNK_SIZE; i < last; ++i) {
+            const DocumentOrdinal ordinal = first_ordinal + static_cast<DocumentOrdinal>(i);
+            for (const auto [term, freq] : documents[i]) {
+                delta_[term][positions[chunk][term]++] = {ordinal, freq};
+            }
+        }
+    });
+
+    std::for_each(policy, terms.begin(), terms.end(), [&](TermId term) {
+        for (size_t i = old_sizes[term]; i < delta_[term].size(); ++i) {
+            max_term_freqs_[term] = std::max(max_term_freqs_[term], delta_[term][i].term_freq);
+        }
+    });
+    delta_size_ = std::transform_reduce(terms.begin(), terms.end(), size_t{0}, std::plus<>(),
+                                        [this](TermId term) {
+                                            return delta_[term].size();
+                                        });
+
+    CompactIfNeeded(policy);
+}
+
+template <typename ExecutionPolicy>
+void InvertedIndex::CompactIfNeeded(const ExecutionPolicy& policy) {
+    if (IsCompactionNeeded()) {
+        Compact(policy);
+    }
+}
+
+template <typename ExecutionPolicy>
+void InvertedIndex::Compact(const ExecutionPolicy& policy) {
+    Rebuild(policy, [](DocumentOrdinal ordinal) {
+        return ordinal;
+    });
+}
+
+template <typename ExecutionPolicy>
+void InvertedIndex::Renumber(const ExecutionPolicy& policy, const std::vector<DocumentOrdinal>& new_ordinals) {
+    Rebuild(policy, [&new_ordinals](DocumentOrdinal ordinal) {
+        return new_ordinals[ordinal];
+    });
+}
+
+template <typename ExecutionPolicy, typename MapOrdinal>
+void InvertedIndex::Rebuild(const ExecutionPolicy& policy, MapOrdinal map_ordinal) {
+    auto segment = std::make_shared<SegmentArrays>();
+    // document_freqs_ равно числу живых постингов слова, отсюда границы слов в новом сегменте
+    segment->offsets.resize(delta_.size() + 1, 0);
+    std::inclusive_scan(document_freqs_.begin(), document_freqs_.end(), segment->offsets.begin() + 1,
+                        std::plus<>(), uint32_t{0});
+    segment->ordinals.resize(segment->offsets.back());
+    segment->term_freqs.resize(segment->offsets.back());
+
+    std::vector<TermId> terms(delta_.size());
+    std::iota(terms.begin(), terms.end(), 0);
+    std::for_each(policy, terms.begin(), terms.end(), [this, &segment, &map_ordinal](TermId term) {
+        size_t position = segment->offsets[term];
+        double max_term_freq = 0.0;
+        ForEachPosting(term, [&](DocumentOrdinal ordinal, double term_freq) {
+            segment->ordinals[position] = map_ordinal(ordinal);
+            segment->term_freqs[position] = term_freq;
+            ++position;
+            max_term_freq = std::max(max_term_freq, term_freq);
+        });
+        max_term_freqs_[term] = max_term_freq;
+    });
+    for (auto& postings : delta_) {
+        postings.clear();
+        postings.shrink_to_fit();
+    }
+
+    if (encoding_ == PostingEncoding::COMPRESSED) {
+        EncodeSegment(policy, *segment);
+    }
+    SetBase(std::move(segment));
+}
+
+template <typename ExecutionPolicy>
+void InvertedIndex::EncodeSegment(const ExecutionPolicy& policy, SegmentArrays& segment) {
+    // Таблица частот: все различные значения или, если их больше 65536, значения
+    // с постоянным отношением соседних между наименьшей и наибольшей частотой
+    std::vector<double> codebook = segment.term_freqs;
+    std::sort(policy, codebook.begin(), codebook.end());
+    codebook.erase(std::unique(codebook.begin(), codebook.end()), codebook.end());
+    constexpr size_t max_codebook_size = size_t{1} << 16;
+    if (codebook.size() > max_codebook_size) {
+        const double low = codebook.front();
+        const double high = codebook.back();
+        codebook.resize(max_codebook_size);
+        for (size_t i = 0; i < max_codebook_size; ++i) {
+            codebook[i] = low * std::pow(high / low, static_cast<double>(i) / (max_codebook_size - 1));
+        }
+        codebook.back() = high;
+    }
+
+    const size_t term_count = segment.offsets.size() - 1;
+    segment.term_blocks.assign(term_count + 1, 0);
+    for (TermId term = 0; term < term_count; ++term) {
+        const size_t posting_count = segment.offsets[term + 1] - segment.offsets[term];
+        segment.term_blocks[term + 1] = segment.term_blocks[term]
+                                        + static_cast<uint32_t>((posting_count + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE);
+    }
+    segment.block_last_ordinals.resize(segment.term_blocks.back());
+    segment.block_offsets.resize(segment.term_blocks.back());
+    segment.term_freq_codes.resize(segment.ordinals.size());
+
+    // Слова кодируются независимо, каждое в свой буфер, затем буферы склеиваются
+    std::vector<std::vector<uint8_t>> term_data(term_count);
+    std::vector<TermId> terms(term_count);
+    std::iota(terms.begin(), terms.end(), 0);
+    std::for_each(policy, terms.begin(), terms.end(), [&](TermId term) {
+        DocumentOrdinal previous = 0;
+        for (size_t block = segment.term_blocks[term]; block < segment.term_blocks[term + 1]; ++block) {
+            const size_t first = segment.offsets[term] + (block - segment.term_blocks[term]) * POSTING_BLOCK_SIZE;
+            const size_t last = std::min<size_t>(first + POSTING_BLOCK_SIZE, segment.offsets[term + 1]);
+            segment.block_offsets[block] = term_data[term].size();
+            segment.block_last_ordinals[block] = segment.ordinals[last - 1];
+            EncodeOrdinals(segment.ordinals.data() + first, last - first, previous, term_data[term]);
+            previous = segment.ordinals[last - 1];
+        }
+
+        double max_term_freq = 0.0;
+        for (size_t pos = segment.offsets[term]; pos < segment.offsets[term + 1]; ++pos) {
+            const uint16_t code = EncodeTermFreq(codebook, segment.term_freqs[pos]);
+            segment.term_freq_codes[pos] = code;
+            max_term_freq = std::max(max_term_freq, codebook[code]);
+        }
+        max_term_freqs_[term] = max_term_freq;
+    });
+
+    size_t data_size = 0;
+    for (TermId term = 0; term < term_count; ++term) {
+        for (size_t block = segment.term_blocks[term]; block < segment.term_blocks[term + 1]; ++block) {
+            segment.block_offsets[block] += data_size;
+        }
+        data_size += term_data[term].size();
+    }
+    segment.block_data.reserve(data_size + POSTING_CODEC_PADDING);
+    for (auto& data : term_data) {
+        segment.block_data.insert(segment.block_data.end(), data.begin(), data.end());
+        std::vector<uint8_t>().swap(data);
+    }
+    segment.block_data.resize(data_size + POSTING_CODEC_PADDING, 0);
+
+    segment.term_freq_codebook = std::move(codebook);
+    std::vector<DocumentOrdinal>().swap(segment.ordinals);
+    std::vector<double>().swap(segment.term_freqs);
+    segment.is_compressed = true;
+}
+
+template <typename ExecutionPolicy>
+void InvertedIndex::RemovePostings(const ExecutionPolicy& policy, DocumentOrdinal ordinal, const std::vector<TermId>& terms) {
+    if (removed_.empty()) {
+        removed_.assign((base_->posting_count + 63) / 64, 0);
+    }
+    std::vector<RemoveResult> results(terms.size());
+    std::transform(policy, terms.begin(), terms.end(), results.begin(),
+                   [this, ordinal](TermId term) {
+                       return RemovePosting(term, ordinal);
+                   });
+    for (const RemoveResult result : results) {
+        if (result == RemoveResult::FROM_DELTA) {
+            --delta_size_;
+        } else if (result == RemoveResult::FROM_BASE) {
+            ++removed_count_;
+        }
+    }
+    CompactIfNeeded(policy);
+}
+
+template <typename Callback>
+void InvertedIndex::ForEachPosting(TermId term, Callback callback) const {
+    // Номера в delta_ всегда больше номеров базового сегмента,
+    // поэтому достаточно обойти сегменты друг за другом
+    // Пометки удаления заводятся при первом удалении
+    const uint64_t* removed = removed_.empty() ? nullptr : removed_.data();
+    if (term < base_->term_count && base_->is_compressed) {
+        std::array<DocumentOrdinal, POSTING_BLOCK_SIZE> ordinals;
+        std::array<double, POSTING_BLOCK_SIZE> term_freqs;
+        for (size_t block = base_->term_blocks[term]; block < base_->term_blocks[term + 1]; ++block) {
+            base_->DecodeBlock(term, block, ordinals.data(), term_freqs.data());
+            const size_t first = base_->GetBlockFirst(term, block);
+            const size_t count = base_->GetBlockEnd(term, block) - first;
+            for (size_t i = 0; i < count; ++i) {
+                if (!IsRemoved(removed, first + i)) {
+                    callback(ordinals[i], term_freqs[i]);
+                }
+            }
+        }
+    } else if (term < base_->term_count) {
+        for (size_t pos = base_->offsets[term]; pos < base_->offsets[term + 1]; ++pos) {
+            if (!IsRemoved(removed, pos)) {
+                callback(base_->ordinals[pos], base_->term_freqs[pos]);
+            }
+        }
+    }
+    for (const Posting& posting : delta_[term]) {
+        callback(posting.ordinal, posting.term_freq);
+    }
+}
@@ -4,11 +4,22 @@
 #include <iostream>
 #include <string_view>
 
+#include "profiler.h"
+
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
+// С флагом сборки SEARCH_SERVER_PROFILE LOG_DURATION не печатает, а пишет интервал
+// в Profiler, PROFILE_SCOPE размечает внутренние этапы. Без флага PROFILE_SCOPE пуст
+#ifdef SEARCH_SERVER_PROFILE
+#define LOG_DURATION(x) ProfileScope UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION_STREAM(x, y) ProfileScope UNIQUE_VAR_NAME_PROFILE(x)
+#define PROFILE_SCOPE(x) ProfileScope UNIQUE_VAR_NAME_PROFILE(x)
+#else
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
 #define LOG_DURATION_STREAM(x, y) LogDuration UNIQUE_VAR_NAME_PROFILE(x, y)
+#define PROFILE_SCOPE(x)
+#endif
 
 class LogDuration {
 public:
@@ -1,79 +1,443 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <future>
 #include <map>
 #include <numeric>
 #include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "concurrent_map.h"
+#include "durable_search_server.h"
+#include "generators.h"
 #include "log_duration.h"
+#include "memory_status.h"
 #include "paginator.h"
 #include "process_queries.h"
+#include "query_executor.h"
 #include "request_queue.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "snapshot_search_server.h"
 #include "test_framework.h"
 
 using namespace std::string_literals;
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution<>(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution<>('a', 'z')(generator));
+template <typename ExecutionPolicy>
+void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
     }
-    return word;
+    cout << total_relevance << endl;
 }
 
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
+#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+
+void TestRetrievalMode(string_view mark, const SearchServer& search_server, const vector<string>& queries, RetrievalMode mode) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT, mode)) {
+            total_relevance += document.relevance;
+        }
     }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
+    cout << total_relevance << endl;
 }
 
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
+// Память на постинг и скорость запросов для несжатых и сжатых постингов
+void TestPostingEncoding(const SearchServer& plain_server, const vector<string>& queries) {
+    SearchServer compressed_server = plain_server;
+    compressed_server.SetPostingEncoding(PostingEncoding::COMPRESSED);
+    const vector<pair<string, const SearchServer*>> servers = {{"plain"s, &plain_server}, {"compressed"s, &compressed_server}};
+    for (const auto& [mark, search_server] : servers) {
+        const IndexMemoryUsage usage = search_server->GetIndexMemoryUsage();
+        cout << mark << ": "s << usage.posting_count << " postings, "s
+             << static_cast<double>(usage.bytes) / usage.posting_count << " bytes per posting"s << endl;
+        TestRetrievalMode(mark + "_exhaustive"s, *search_server, queries, RetrievalMode::EXHAUSTIVE);
+        TestRetrievalMode(mark + "_max_score"s, *search_server, queries, RetrievalMode::MAX_SCORE);
+    }
+}
+
+// Доля запросов IDF, обслуженных кэшем, и стоимость пересчёта таблицы после пакетного добавления
+void ReportInverseDocumentFreqCache(string_view mark, const SearchServer& search_server) {
+    const InverseDocumentFreqCacheStats stats = search_server.GetInverseDocumentFreqCacheStats();
+    const uint64_t lookups = stats.hits + stats.misses;
+    cout << mark << ": idf hit rate "s << (lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups) << "% of "s << lookups
+         << ", "s << stats.refresh_count << " refreshes of "s << stats.refreshed_terms << " terms in "s
+         << chrono::duration_cast<chrono::microseconds>(stats.refresh_duration).count() << " us"s << endl;
+}
+
+// Популярные запросы повторяются: ProcessQueries без кэша и с кэшем результатов
+void TestQueryResultCache(const SearchServer& search_server, const vector<string>& queries) {
+    vector<string> repeated_queries;
+    for (size_t i = 0; i < 5; ++i) {
+        repeated_queries.insert(repeated_queries.end(), queries.begin(), queries.end());
+    }
+    SearchServer cached_server = search_server;
+    cached_server.SetQueryResultCacheCapacity(1 << 20);
+    const vector<pair<string, const SearchServer*>> servers = {{"process_queries_uncached"s, &search_server},
+                                                                {"process_queries_cached"s, &cached_server}};
+    for (const auto& [mark, server] : servers) {
+        double total_relevance = 0;
+        {
+            LOG_DURATION(mark);
+            for (const auto& documents : ProcessQueries(*server, repeated_queries)) {
+                for (const Document& document : documents) {
+                    total_relevance += document.relevance;
+                }
+            }
+        }
+        cout << total_relevance << endl;
+    }
+    const QueryResultCacheStats stats = cached_server.GetQueryResultCacheStats();
+    cout << "query cache: "s << stats.hits << " hits, "s << stats.misses << " misses, "s
+         << stats.entry_count << " entries, "s << stats.bytes << " bytes"s << endl;
+}
+
+template <typename Process>
+void TestPeakMemory(string_view mark, Process process) {
+    ResetPeakMemory();
+    const size_t memory_before = ReadMemoryStatus("VmRSS:"sv);
+    double total_relevance = 0;
+    {
+        LOG_DURATION(mark);
+        total_relevance = process();
+    }
+    cout << total_relevance << ", peak memory +"s << ReadMemoryStatus("VmHWM:"sv) - memory_before << " KB"s << endl;
+}
+
+// Большой пакет коротких запросов: результаты целиком, склеенные и потоком
+void TestProcessQueriesStreaming(const SearchServer& search_server, const vector<string>& queries) {
+    TestPeakMemory("process_queries"sv, [&] {
+        double total_relevance = 0;
+        for (const auto& documents : ProcessQueries(search_server, queries)) {
+            for (const Document& document : documents) {
+                total_relevance += document.relevance;
+            }
         }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
+        return total_relevance;
+    });
+    TestPeakMemory("process_queries_joined"sv, [&] {
+        double total_relevance = 0;
+        for (const Document& document : ProcessQueriesJoined(search_server, queries)) {
+            total_relevance += document.relevance;
+        }
+        return total_relevance;
+    });
+    const vector<string_view> query_views(queries.begin(), queries.end());
+    TestPeakMemory("process_queries_streaming"sv, [&] {
+        double total_relevance = 0;
+        ProcessQueriesStreaming(search_server, query_views, [&total_relevance](size_t, vector<Document>&& documents) {
+            for (const Document& document : documents) {
+                total_relevance += document.relevance;
+            }
+        });
+        return total_relevance;
+    });
+}
+
+// Пакет коротких запросов по небольшому словарю: каждое слово встречается во многих запросах
+template <typename Process>
+void TestProcessQueriesBatch(string_view mark, const SearchServer& search_server, const vector<string>& queries, Process process) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const auto& documents : process(search_server, queries)) {
+        for (const Document& document : documents) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+
+// RequestQueue, заполняемая из параллельных потоков, как в ProcessQueries
+void TestRequestQueue(const SearchServer& search_server, const vector<string>& queries) {
+    LOG_DURATION("request_queue_par"sv);
+    RequestQueue request_queue(search_server);
+    double total_relevance = 0;
+    vector<vector<Document>> results(queries.size());
+    transform(execution::par, queries.begin(), queries.end(), results.begin(), [&request_queue](const string& query) {
+        return request_queue.AddFindRequest(query);
+    });
+    for (const auto& documents : results) {
+        for (const Document& document : documents) {
+            total_relevance += document.relevance;
         }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
     }
-    return query;
+    cout << total_relevance << ", "s << request_queue.GetRequestCount() << " requests, "s
+         << request_queue.GetNoResultRequests() << " without result"s << endl;
+    const RequestQueueStats stats = request_queue.GetStats();
+    const auto to_ms = [](chrono::nanoseconds duration) {
+        return chrono::duration<double, milli>(duration).count();
+    };
+    cout << "request_queue_stats: "s << stats.requests_per_second << " qps, p50 "s << to_ms(stats.latency_p50)
+         << " ms, p90 "s << to_ms(stats.latency_p90) << " ms, p99 "s << to_ms(stats.latency_p99)
+         << " ms, p999 "s << to_ms(stats.latency_p999) << " ms, mean results "s << stats.result_counts.GetMean() << endl;
+}
+
+// Значение перцентиля percent отсортированных длительностей в мс
+double GetPercentileMs(const vector<chrono::steady_clock::duration>& sorted_durations, double percent) {
+    const size_t index = min(sorted_durations.size() - 1, static_cast<size_t>(percent / 100 * sorted_durations.size()));
+    return chrono::duration<double, milli>(sorted_durations[index]).count();
+}
+
+void PrintLatencies(string_view mark, vector<chrono::steady_clock::duration> durations) {
+    sort(durations.begin(), durations.end());
+    cout << mark << ": p50 "s << GetPercentileMs(durations, 50) << " ms, p99 "s << GetPercentileMs(durations, 99) << " ms"s << endl;
 }
 
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+// Смесь коротких и длинных запросов. В ProcessQueries ответ на любой запрос готов только
+// вместе со всем пакетом, QueryExecutor отдаёт каждый ответ по готовности
+void TestQueryExecutor(const SearchServer& search_server, mt19937& generator, const vector<string>& dictionary) {
     vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    for (size_t i = 0; i < 400; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, i % 10 == 0 ? 70 : 3));
+    }
+
+    const auto batch_start = chrono::steady_clock::now();
+    double total_relevance = 0;
+    for (const auto& documents : ProcessQueries(search_server, queries)) {
+        for (const Document& document : documents) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+    PrintLatencies("process_queries_latency"sv, vector(queries.size(), chrono::steady_clock::now() - batch_start));
+
+    QueryExecutor executor(search_server);
+    for (const auto timeout : {chrono::steady_clock::duration::max(), chrono::steady_clock::duration(chrono::milliseconds(2))}) {
+        const auto start = chrono::steady_clock::now();
+        vector<future<QueryResult>> results;
+        for (const string& query : queries) {
+            results.push_back(executor.Submit(query, {DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT, timeout}));
+        }
+        vector<chrono::steady_clock::duration> latencies;
+        total_relevance = 0;
+        size_t incomplete_count = 0;
+        for (auto& result : results) {
+            const QueryResult query_result = result.get();
+            latencies.push_back(chrono::steady_clock::now() - start);
+            incomplete_count += query_result.is_complete ? 0 : 1;
+            for (const Document& document : query_result.documents) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << ", "s << incomplete_count << " incomplete"s << endl;
+        PrintLatencies(timeout == chrono::steady_clock::duration::max() ? "query_executor_latency"sv : "query_executor_2ms_deadline_latency"sv,
+                       latencies);
+    }
+}
+
+void TestAddDocumentLoop(string_view mark, const string& stop_words, const vector<string>& documents) {
+    SearchServer search_server(stop_words);
+    LOG_DURATION(mark);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
     }
-    return queries;
 }
 
 template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+void TestAddDocuments(string_view mark, const string& stop_words, const vector<string>& documents, ExecutionPolicy&& policy) {
+    vector<DocumentInput> batch;
+    batch.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    SearchServer search_server(stop_words);
+    {
+        LOG_DURATION(mark);
+        search_server.AddDocuments(policy, batch);
+    }
+    ReportInverseDocumentFreqCache(mark, search_server);
+}
+
+void TestSnapshotQueries(string_view mark, const SnapshotSearchServer& search_server, const vector<string>& queries) {
     LOG_DURATION(mark);
     double total_relevance = 0;
     for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+        for (const auto& document : search_server.FindTopDocuments(query)) {
             total_relevance += document.relevance;
         }
     }
     cout << total_relevance << endl;
 }
 
-#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+// Время запуска: повторное добавление всех документов против загрузки сохранённого индекса
+void TestIndexStartup(const string& stop_words, const vector<string>& documents, const vector<string>& queries) {
+    vector<DocumentInput> batch;
+    batch.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    const string path = (filesystem::temp_directory_path() / "search_server_index.bin"s).string();
+    {
+        SearchServer search_server(stop_words);
+        {
+            LOG_DURATION("startup_rebuild"sv);
+            search_server.AddDocuments(batch);
+        }
+        LOG_DURATION("save_index"sv);
+        search_server.SaveIndex(path);
+    }
+    double total_relevance = 0;
+    {
+        LOG_DURATION("startup_load_index"sv);
+        const SearchServer search_server = SearchServer::LoadIndex(path);
+        for (const auto& document : search_server.FindTopDocuments(queries.front())) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+    filesystem::remove(path);
+}
+
+// Добавление с журналом, восстановление воспроизведением журнала и свёртка журнала в снимок
+void TestDurableIngest(const string& stop_words, const vector<string>& documents) {
+    const auto directory = filesystem::temp_directory_path() / "search_server_durable"s;
+    filesystem::remove_all(directory);
+    {
+        DurableSearchServer search_server(directory.string(), stop_words);
+        LOG_DURATION("durable_add_document_loop"sv);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        search_server.Sync();
+    }
+    {
+        LOG_DURATION("durable_replay_log"sv);
+        DurableSearchServer search_server(directory.string(), stop_words);
+    }
+    {
+        DurableSearchServer search_server(directory.string(), stop_words);
+        LOG_DURATION("durable_checkpoint"sv);
+        search_server.Checkpoint();
+    }
+    {
+        LOG_DURATION("durable_load_checkpoint"sv);
+        DurableSearchServer search_server(directory.string(), stop_words);
+    }
+    filesystem::remove_all(directory);
+}
+
+void TestShardedQueries(string_view mark, const string& stop_words, const vector<string>& documents, const vector<string>& queries, size_t shard_count) {
+    ShardedSearchServer search_server(stop_words, shard_count);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+
+// Конкурентные инкременты по key_count ключам из нескольких потоков
+template <typename Key, typename MakeKey>
+void TestConcurrentMapIncrements(string_view mark, size_t key_count, MakeKey make_key) {
+    const size_t thread_count = max<size_t>(4, thread::hardware_concurrency());
+    const size_t increment_count = 1'000'000;
+    vector<Key> keys(key_count);
+    for (size_t i = 0; i < key_count; ++i) {
+        keys[i] = make_key(i);
+    }
+    ConcurrentMap<Key, int> increments(101);
+    {
+        LOG_DURATION(mark);
+        vector<thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&increments, &keys, t] {
+                mt19937 generator(t);
+                for (size_t i = 0; i < increment_count; ++i) {
+                    increments[keys[generator() % keys.size()]].ref_to_value += 1;
+                }
+            });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+    }
+    atomic<int> total = 0;
+    increments.ForEach(execution::par, [&total](const Key&, int value) {
+        total += value;
+    });
+    cout << increments.GetSize() << " keys, "s << total << " increments"s << endl;
+}
+
+void TestConcurrentMap(const vector<string>& dictionary) {
+    const auto make_int = [](size_t i) {
+        return static_cast<int>(i);
+    };
+    TestConcurrentMapIncrements<int>("concurrent_map_int_hot"sv, 16, make_int);
+    TestConcurrentMapIncrements<int>("concurrent_map_int_wide"sv, 100'000, make_int);
+    TestConcurrentMapIncrements<string>("concurrent_map_term"sv, dictionary.size(), [&dictionary](size_t i) {
+        return dictionary[i];
+    });
+}
+
+// Время запросов без записи и во время фонового добавления документов
+void TestQueriesDuringIngest(const string& stop_words, const vector<string>& documents, const vector<string>& queries) {
+    SnapshotSearchServer search_server(stop_words);
+    const size_t initial_count = documents.size() / 2;
+    vector<DocumentInput> batch;
+    for (size_t i = 0; i < initial_count; ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    search_server.AddDocuments(batch);
+
+    TestSnapshotQueries("snapshot_idle"sv, search_server, queries);
+    thread writer([&search_server, &documents, initial_count] {
+        for (size_t i = initial_count; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    });
+    TestSnapshotQueries("snapshot_during_ingest"sv, search_server, queries);
+    writer.join();
+}
+
+// Задержка добавления документа в большой индекс, пока читатели непрерывно держат версии
+void TestIngestWithReaders(const string& stop_words, const vector<string>& documents, const vector<string>& queries, size_t reader_count) {
+    constexpr size_t added_count = 1'000;
+    SnapshotSearchServer search_server(stop_words);
+    const size_t initial_count = documents.size() - added_count;
+    vector<DocumentInput> batch;
+    for (size_t i = 0; i < initial_count; ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    search_server.AddDocuments(batch);
+
+    atomic<bool> stop = false;
+    vector<thread> readers;
+    for (size_t reader = 0; reader < reader_count; ++reader) {
+        readers.emplace_back([&search_server, &queries, &stop, reader] {
+            for (size_t i = reader; !stop.load(); ++i) {
+                search_server.FindTopDocuments(queries[i % queries.size()]);
+            }
+        });
+    }
+    vector<chrono::steady_clock::duration> latencies;
+    for (size_t i = initial_count; i < documents.size(); ++i) {
+        const auto start = chrono::steady_clock::now();
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        latencies.push_back(chrono::steady_clock::now() - start);
+    }
+    stop = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    PrintLatencies("snapshot_add_document_"s + to_string(reader_count) + "_readers"s, latencies);
+}
 
 int main() {
     mt19937 generator;
@@ -86,4 +450,43 @@ int main() {
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    TestRetrievalMode("exhaustive"sv, search_server, queries, RetrievalMode::EXHAUSTIVE);
+    TestRetrievalMode("max_score"sv, search_server, queries, RetrievalMode::MAX_SCORE);
+    ReportInverseDocumentFreqCache("queries"sv, search_server);
+    TestPostingEncoding(search_server, queries);
+    TestQueryResultCache(search_server, queries);
+    TestQueryExecutor(search_server, generator, dictionary);
+    {
+        const auto short_queries = GenerateQueries(generator, dictionary, 10'000, 3);
+        TestProcessQueriesStreaming(search_server, short_queries);
+        TestProcessQueriesBatch("process_queries"sv, search_server, short_queries, ProcessQueries);
+        TestProcessQueriesBatch("process_queries_batched"sv, search_server, short_queries, ProcessQueriesBatched);
+        TestRequestQueue(search_server, vector(short_queries.begin(), short_queries.begin() + 2'000));
+    }
+
+    TestShardedQueries("sharded_1"sv, dictionary[0], documents, queries, 1);
+    TestShardedQueries("sharded_4"sv, dictionary[0], documents, queries, 4);
+
+    TestQueriesDuringIngest(dictionary[0], documents, queries);
+    TestConcurrentMap(dictionary);
+
+    for (const int document_count : {10'000, 100'000}) {
+        const auto corpus = GenerateQueries(generator, dictionary, document_count, 70);
+        cout << "ingest "s << document_count << " documents"s << endl;
+        TestAddDocumentLoop("add_document_loop"sv, dictionary[0], corpus);
+        TestAddDocuments("add_documents_seq"sv, dictionary[0], corpus, execution::seq);
+        TestAddDocuments("add_documents_par"sv, dictionary[0], corpus, execution::par);
+        TestIndexStartup(dictionary[0], corpus, queries);
+        TestDurableIngest(dictionary[0], corpus);
+        TestIngestWithReaders(dictionary[0], corpus, queries, 0);
+        TestIngestWithReaders(dictionary[0], corpus, queries, 3);
+    }
+
+#ifdef SEARCH_SERVER_PROFILE
+    Profiler::Instance().PrintReport(cerr);
+    const auto trace_path = filesystem::temp_directory_path() / "search_server_trace.json"s;
+    ofstream trace(trace_path);
+    Profiler::Instance().WriteChromeTrace(trace);
+    cerr << "trace: "s << trace_path.string() << endl;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include <fstream>
+#include <string>
+
+#include <malloc.h>
+
+#include "memory_status.h"
+
+using namespace std;
+
+size_t ReadMemoryStatus(string_view field) {
+    ifstream status("/proc/self/status"s);
+    for (string line; getline(status, line);) {
+        if (line.compare(0, field.size(), field) == 0) {
+            return stoul(line.substr(field.size()));
+        }
+    }
+    return 0;
+}
+
+void ResetPeakMemory() {
+    // Освобождённая ранее память кучи иначе переиспользуется без роста RSS
+    malloc_trim(0);
+    ofstream("/proc/self/clear_refs"s) << "5"s;
+}
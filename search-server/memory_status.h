@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Поле /proc/self/status в КБ, например "VmRSS:" или пиковое "VmHWM:", 0 вне Linux
+size_t ReadMemoryStatus(std::string_view field);
+
+// Опускает пик VmHWM до текущего размера
+void ResetPeakMemory();
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "operation_log.h"
+
+using namespace std;
+
+namespace {
+
+struct RecordHeader {
+    uint32_t payload_size;
+    uint32_t checksum;
+};
+
+uint32_t ComputeRecordChecksum(const char* data, size_t size) {
+    uint32_t checksum = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        checksum = (checksum ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return checksum;
+}
+
+template <typename T>
+void AppendValue(std::string& output, const T& value) {
+    output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Читает значение из [position, end), при нехватке данных возвращает false
+template <typename T>
+bool ReadValue(const char*& position, const char* end, T& value) {
+    if (static_cast<size_t>(end - position) < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, position, sizeof(value));
+    position += sizeof(value);
+    return true;
+}
+
+void WriteAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            throw std::runtime_error("Cannot write operation log"s);
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+} // namespace
+
+OperationLog::OperationLog(const std::string& path)
+    : fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644)) {
+    if (fd_ < 0) {
+        throw std::runtime_error("Cannot open operation log "s + path);
+    }
+    flusher_ = std::thread([this] {
+        RunFlusher();
+    });
+}
+
+OperationLog::~OperationLog() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    flush_needed_.notify_one();
+    flusher_.join();
+    try {
+        Sync();
+    } catch (...) {
+        // Из деструктора ошибку передать некуда
+    }
+    close(fd_);
+}
+
+void OperationLog::LogAddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::string record;
+    AppendAddDocumentRecord(record, document_id, document, status, ratings);
+    Write(record);
+}
+
+void OperationLog::LogAddDocuments(const std::vector<DocumentInput>& documents, size_t count) {
+    std::string records;
+    for (size_t i = 0; i < count; ++i) {
+        AppendAddDocumentRecord(records, documents[i].id, documents[i].text, documents[i].status, documents[i].ratings);
+    }
+    if (!records.empty()) {
+        Write(records);
+    }
+}
+
+void OperationLog::LogRemoveDocument(int document_id) {
+    std::string payload;
+    AppendValue(payload, RecordType::REMOVE_DOCUMENT);
+    AppendValue(payload, document_id);
+    std::string record;
+    AppendRecord(record, payload);
+    Write(record);
+}
+
+void OperationLog::Sync() {
+    uint64_t written = 0;
+    {
+        std::lock_guard lock(mutex_);
+        if (sync_error_) {
+            std::rethrow_exception(std::exchange(sync_error_, nullptr));
+        }
+        if (synced_ == written_) {
+            return;
+        }
+        written = written_;
+        unsynced_ = false;
+    }
+    SyncFile(written);
+}
+
+void OperationLog::AppendAddDocumentRecord(std::string& output, int document_id, const std::string_view document,
+                                           DocumentStatus status, const std::vector<int>& ratings) {
+    std::string payload;
+    payload.reserve(1 + 3 * sizeof(uint32_t) + ratings.size() * sizeof(int) + sizeof(uint32_t) + document.size());
+    AppendValue(payload, RecordType::ADD_DOCUMENT);
+    AppendValue(payload, document_id);
+    AppendValue(payload, status);
+    AppendValue(payload, static_cast<uint32_t>(ratings.size()));
+    payload.append(reinterpret_cast<const char*>(ratings.data()), ratings.size() * sizeof(int));
+    AppendValue(payload, static_cast<uint32_t>(document.size()));
+    payload.append(document);
+    AppendRecord(output, payload);
+}
+
+void OperationLog::AppendRecord(std::string& output, const std::string& payload) {
+    AppendValue(output, RecordHeader{static_cast<uint32_t>(payload.size()),
+                                     ComputeRecordChecksum(payload.data(), payload.size())});
+    output += payload;
+}
+
+void OperationLog::Write(const std::string& records) {
+    WriteAll(fd_, records.data(), records.size());
+    bool notify = false;
+    {
+        std::lock_guard lock(mutex_);
+        ++written_;
+        if (!unsynced_) {
+            unsynced_ = true;
+            first_unsynced_ = std::chrono::steady_clock::now();
+            notify = true;
+        }
+    }
+    if (notify) {
+        flush_needed_.notify_one();
+    }
+}
+
+void OperationLog::SyncFile(uint64_t synced) {
+    if (fdatasync(fd_) != 0) {
+        throw std::runtime_error("Cannot sync operation log"s);
+    }
+    std::lock_guard lock(mutex_);
+    synced_ = std::max(synced_, synced);
+}
+
+void OperationLog::RunFlusher() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        flush_needed_.wait(lock, [this] {
+            return unsynced_ || stopping_;
+        });
+        if (stopping_) {
+            return;
+        }
+        // Записи, сделанные за интервал, синхронизируются вместе
+        flush_needed_.wait_until(lock, first_unsynced_ + OPERATION_LOG_GROUP_COMMIT_INTERVAL, [this] {
+            return stopping_;
+        });
+        if (stopping_) {
+            return;
+        }
+        if (!unsynced_) {
+            continue;
+        }
+        // Записи, сделанные во время fdatasync, снова выставят флаг
+        unsynced_ = false;
+        const uint64_t written = written_;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            SyncFile(written);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        if (error) {
+            sync_error_ = error;
+        }
+    }
+}
+
+size_t OperationLog::Replay(const std::string& path, SearchServer& search_server) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        return 0;
+    }
+    const std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+
+    // Тексты документов пакета указывают прямо в data
+    std::vector<DocumentInput> batch;
+    const auto apply_batch = [&search_server, &batch] {
+        search_server.AddDocuments(std::execution::par, batch);
+        batch.clear();
+    };
+
+    size_t record_count = 0;
+    const char* position = data.data();
+    const char* const end = data.data() + data.size();
+    while (position != end) {
+        const char* record = position;
+        RecordHeader header;
+        if (!ReadValue(record, end, header)
+            || static_cast<size_t>(end - record) < header.payload_size
+            || ComputeRecordChecksum(record, header.payload_size) != header.checksum) {
+            break;
+        }
+        const char* const record_end = record + header.payload_size;
+
+        RecordType type;
+        int document_id = 0;
+        if (!ReadValue(record, record_end, type) || !ReadValue(record, record_end, document_id)) {
+            throw std::invalid_argument("Invalid operation log record"s);
+        }
+        if (type == RecordType::ADD_DOCUMENT) {
+            DocumentInput document;
+            document.id = document_id;
+            uint32_t rating_count = 0;
+            if (!ReadValue(record, record_end, document.status) || !ReadValue(record, record_end, rating_count)) {
+                throw std::invalid_argument("Invalid operation log record"s);
+            }
+            document.ratings.resize(rating_count);
+            for (int& rating : document.ratings) {
+                if (!ReadValue(record, record_end, rating)) {
+                    throw std::invalid_argument("Invalid operation log record"s);
+                }
+            }
+            uint32_t text_size = 0;
+            if (!ReadValue(record, record_end, text_size) || static_cast<size_t>(record_end - record) != text_size) {
+                throw std::invalid_argument("Invalid operation log record"s);
+            }
+            document.text = std::string_view(record, text_size);
+            batch.push_back(std::move(document));
+        } else if (type == RecordType::REMOVE_DOCUMENT) {
+            apply_batch();
+            search_server.RemoveDocument(document_id);
+        } else {
+            throw std::invalid_argument("Invalid operation log record"s);
+        }
+        position = record_end;
+        ++record_count;
+    }
+    apply_batch();
+
+    if (position != end) {
+        std::filesystem::resize_file(path, position - data.data());
+    }
+    return record_count;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Не дольше этого времени запись может оставаться не синхронизированной с диском
+constexpr std::chrono::milliseconds OPERATION_LOG_GROUP_COMMIT_INTERVAL{10};
+
+// Журнал изменений SearchServer, файл только дописывается.
+// Каждая запись хранит свою длину и контрольную сумму, поэтому запись, оборванная
+// при падении процесса, обнаруживается и отбрасывается при воспроизведении.
+// Запись сразу передаётся в файл и переживает падение процесса. fdatasync выполняет
+// фоновый поток, один на все записи, сделанные за OPERATION_LOG_GROUP_COMMIT_INTERVAL,
+// поэтому при падении системы теряются записи только за последний интервал.
+// Ошибка фоновой синхронизации выбрасывается из следующего вызова Sync.
+class OperationLog {
+public:
+    explicit OperationLog(const std::string& path);
+    OperationLog(const OperationLog&) = delete;
+    OperationLog& operator=(const OperationLog&) = delete;
+    ~OperationLog();
+
+    void LogAddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Пишет первые count документов одним обращением к файлу
+    void LogAddDocuments(const std::vector<DocumentInput>& documents, size_t count);
+    void LogRemoveDocument(int document_id);
+
+    // Дожидается попадания всех записей на диск
+    void Sync();
+
+    // Применяет журнал к серверу. Подряд идущие добавления применяются одним пакетом
+    // AddDocuments. Оборванный конец файла отрезается. Возвращает число записей.
+    static size_t Replay(const std::string& path, SearchServer& search_server);
+
+private:
+    enum class RecordType : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+    };
+
+    int fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable flush_needed_;
+    // Номер последней записи в файл и последней записи, точно попавшей на диск
+    uint64_t written_ = 0;
+    uint64_t synced_ = 0;
+    // Есть записи, для которых фоновый поток ещё не начал fdatasync
+    bool unsynced_ = false;
+    std::chrono::steady_clock::time_point first_unsynced_;
+    std::exception_ptr sync_error_;
+    bool stopping_ = false;
+    std::thread flusher_;
+
+    static void AppendAddDocumentRecord(std::string& output, int document_id, const std::string_view document,
+                                        DocumentStatus status, const std::vector<int>& ratings);
+    static void AppendRecord(std::string& output, const std::string& payload);
+    void Write(const std::string& records);
+    // fdatasync без блокировки, затем отмечает синхронизированными записи до synced включительно
+    void SyncFile(uint64_t synced);
+    void RunFlusher();
+};
@@ -0,0 +1,124 @@
+#include <array>
+
+#include "posting_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define POSTING_CODEC_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+size_t GetByteLength(uint32_t value) {
+    return value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+}
+
+size_t GetControlLength(size_t count) {
+    return (count + 3) / 4;
+}
+
+const uint8_t* DecodeOrdinalsScalar(const uint8_t* control, const uint8_t* data, size_t first, size_t count,
+                                    uint32_t previous, uint32_t* output) {
+    for (size_t i = first; i < count; ++i) {
+        const size_t length = ((control[i / 4] >> (i % 4 * 2)) & 3) + 1;
+        uint32_t delta = 0;
+        for (size_t byte = 0; byte < length; ++byte) {
+            delta |= static_cast<uint32_t>(data[byte]) << (8 * byte);
+        }
+        data += length;
+        previous += delta;
+        output[i] = previous;
+    }
+    return data;
+}
+
+#ifdef POSTING_CODEC_X86
+
+// Для каждого контрольного байта: перестановка, раскладывающая четыре разности
+// по 32-битным ячейкам, и суммарная длина четырёх разностей
+struct ShuffleTables {
+    std::array<std::array<uint8_t, 16>, 256> masks;
+    std::array<uint8_t, 256> lengths;
+};
+
+ShuffleTables MakeShuffleTables() {
+    ShuffleTables tables;
+    for (size_t control = 0; control < 256; ++control) {
+        uint8_t offset = 0;
+        for (size_t value = 0; value < 4; ++value) {
+            const size_t length = ((control >> (value * 2)) & 3) + 1;
+            for (size_t byte = 0; byte < 4; ++byte) {
+                tables.masks[control][value * 4 + byte] = byte < length ? offset + byte : 0x80;
+            }
+            offset += length;
+        }
+        tables.lengths[control] = offset;
+    }
+    return tables;
+}
+
+// Таблицы строятся при первом вызове, чтобы декодер работал и в инициализаторах
+// глобальных объектов других файлов
+const ShuffleTables& GetShuffleTables() {
+    static const ShuffleTables tables = MakeShuffleTables();
+    return tables;
+}
+
+__attribute__((target("ssse3")))
+const uint8_t* DecodeOrdinalsSsse3(const uint8_t* control, const uint8_t* data, size_t count,
+                                   uint32_t previous, uint32_t* output) {
+    const ShuffleTables& tables = GetShuffleTables();
+    __m128i running = _mm_set1_epi32(static_cast<int>(previous));
+    const size_t group_count = count / 4;
+    for (size_t group = 0; group < group_count; ++group) {
+        const uint8_t code = control[group];
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.masks[code].data()));
+        data += tables.lengths[code];
+
+        // Префиксные суммы четырёх разностей плюс последний номер предыдущей четвёрки
+        __m128i values = _mm_shuffle_epi8(bytes, mask);
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+        values = _mm_add_epi32(values, running);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + group * 4), values);
+        running = _mm_shuffle_epi32(values, 0xFF);
+    }
+    previous = group_count > 0 ? output[group_count * 4 - 1] : previous;
+    return DecodeOrdinalsScalar(control, data, group_count * 4, count, previous, output);
+}
+
+bool HasSsse3() {
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+}
+
+#endif
+
+} // namespace
+
+void EncodeOrdinals(const uint32_t* values, size_t count, uint32_t previous, std::vector<uint8_t>& output) {
+    const size_t control_first = output.size();
+    output.resize(control_first + GetControlLength(count), 0);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t delta = values[i] - previous;
+        previous = values[i];
+        const size_t length = GetByteLength(delta);
+        output[control_first + i / 4] |= static_cast<uint8_t>((length - 1) << (i % 4 * 2));
+        for (size_t byte = 0; byte < length; ++byte) {
+            output.push_back(static_cast<uint8_t>(delta >> (8 * byte)));
+        }
+    }
+}
+
+const uint8_t* DecodeOrdinals(const uint8_t* input, size_t count, uint32_t previous, uint32_t* output) {
+    const uint8_t* data = input + GetControlLength(count);
+#ifdef POSTING_CODEC_X86
+    if (HasSsse3()) {
+        return DecodeOrdinalsSsse3(input, data, count, previous, output);
+    }
+#endif
+    return DecodeOrdinalsScalar(input, data, 0, count, previous, output);
+}
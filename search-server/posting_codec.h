@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Сжатие возрастающих номеров документов в стиле StreamVByte: хранятся разности соседних
+// номеров, каждая занимает 1-4 байта. Длины лежат отдельно, по 2 бита на разность,
+// так что четыре разности декодируются одной перестановкой байт (SSSE3 pshufb).
+// Без SSSE3 используется скалярный декодер. Версии для AVX2 нет: перестановка pshufb
+// работает внутри 128-битных половин регистра, и декодер остаётся на SSSE3.
+
+// Число номеров в блоке сжатого списка постингов
+constexpr size_t POSTING_BLOCK_SIZE = 128;
+// Декодер читает данные по 16 байт и может заглянуть за конец последнего блока
+constexpr size_t POSTING_CODEC_PADDING = 16;
+
+// Дописывает в output count номеров, первая разность считается от previous
+void EncodeOrdinals(const uint32_t* values, size_t count, uint32_t previous, std::vector<uint8_t>& output);
+
+// Декодирует count номеров, записанных EncodeOrdinals с тем же previous.
+// Возвращает указатель на конец блока
+const uint8_t* DecodeOrdinals(const uint8_t* input, size_t count, uint32_t previous, uint32_t* output);
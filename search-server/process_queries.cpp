@@ -8,24 +8,22 @@ std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_ser
     std::vector<std::vector<Document>> result(queries.size());
     std::transform(std::execution::par,
                    queries.begin(), queries.end(), result.begin(),
-                   [&search_server](std::string const qry) {
+                   [&search_server](const std::string& qry) {
                        return search_server.FindTopDocuments(qry);
                    });
     return result;
 }
 
+std::vector<std::vector<Document>> ProcessQueriesBatched(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
+}
+
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server,
                      const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> documents(queries.size());
-    std::transform(std::execution::par,
-                   queries.begin(), queries.end(), documents.begin(),
-                   [&search_server](std::string const qry) {
-                       return search_server.FindTopDocuments(qry);
-                   });
+    // Результаты частей сразу переносятся в общий вектор, а не копятся по запросам
     std::vector<Document> result;
-    std::vector<Document>::iterator it;
-    for (const std::vector<Document>& v : documents) {
-        it = result.insert(result.end(), v.begin(), v.end());
-    }
+    ProcessQueriesStreaming(search_server, queries, [&result](size_t, std::vector<Document>&& documents) {
+        result.insert(result.end(), documents.begin(), documents.end());
+    });
     return result;
-}
\ No newline at end of file
+}
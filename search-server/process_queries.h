@@ -1,8 +1,42 @@
 #pragma once
 
+#include <algorithm>
+#include <execution>
+#include <string_view>
+#include <vector>
+
 #include "search_server.h"
 
+// Сколько запросов ProcessQueriesStreaming обрабатывает за раз
+constexpr size_t PROCESS_QUERIES_CHUNK_SIZE = 1024;
+
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
+// Результат совпадает с ProcessQueries. Постинги слов, общих для запросов пакета, обходятся
+// один раз на группу запросов (см. SearchServer::FindTopDocumentsBatch): выше пропускная
+// способность на больших пакетах, но ответ на любой запрос готов только вместе с группой
+std::vector<std::vector<Document>> ProcessQueriesBatched(const SearchServer& search_server, const std::vector<std::string>& queries);
+
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
 
+// Вызывает sink(номер запроса, std::vector<Document>&&) для каждого запроса по порядку номеров.
+// Запросы обрабатываются параллельно частями по chunk_size, и в памяти одновременно лежат
+// результаты только одной части, сколько бы ни было запросов.
+// queries — контейнер с произвольным доступом из строк или string_view
+template <typename QueryContainer, typename Sink>
+void ProcessQueriesStreaming(const SearchServer& search_server, const QueryContainer& queries, Sink sink,
+                             size_t chunk_size = PROCESS_QUERIES_CHUNK_SIZE) {
+    chunk_size = std::max<size_t>(chunk_size, 1);
+    std::vector<std::vector<Document>> results(std::min(chunk_size, queries.size()));
+    for (size_t first = 0; first < queries.size(); first += chunk_size) {
+        const size_t count = std::min(chunk_size, queries.size() - first);
+        const auto chunk_begin = queries.begin() + first;
+        std::transform(std::execution::par, chunk_begin, chunk_begin + count, results.begin(),
+                       [&search_server](const auto& query) {
+                           return search_server.FindTopDocuments(std::string_view(query));
+                       });
+        for (size_t i = 0; i < count; ++i) {
+            sink(first + i, std::move(results[i]));
+        }
+    }
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <unordered_map>
+
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+double ToMicroseconds(int64_t nanoseconds) {
+    return nanoseconds / 1000.0;
+}
+
+// Имена интервалов — идентификаторы, но кавычки и обратная косая черта всё же экранируются
+void WriteJsonString(std::ostream& output, std::string_view text) {
+    output << '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            output << '\\';
+        }
+        output << c;
+    }
+    output << '"';
+}
+
+} // namespace
+
+Profiler& Profiler::Instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::PrintReport(std::ostream& output) const {
+    // Путь интервала — имена от корня потока, std::map упорядочивает родителей перед детьми
+    std::map<std::vector<std::string_view>, std::vector<int64_t>> durations;
+    size_t lost_count = 0;
+    for (const auto& [thread_index, events] : CopyEvents()) {
+        std::unordered_map<uint32_t, const Event*> events_by_id;
+        for (const Event& event : events) {
+            events_by_id[event.id] = &event;
+        }
+        for (const Event& event : events) {
+            std::vector<std::string_view> path = {event.name};
+            for (auto parent = events_by_id.find(event.parent); parent != events_by_id.end();
+                 parent = events_by_id.find(parent->second->parent)) {
+                path.push_back(parent->second->name);
+            }
+            std::reverse(path.begin(), path.end());
+            durations[std::move(path)].push_back(event.duration_ns);
+        }
+    }
+    {
+        std::lock_guard guard(mutex_);
+        for (const auto& buffer : buffers_) {
+            std::lock_guard buffer_guard(buffer->mutex);
+            lost_count += buffer->lost_count;
+        }
+    }
+
+    const auto flags = output.flags();
+    constexpr int width = 14;
+    output << std::left << std::setw(40) << "scope"s << std::right
+           << std::setw(10) << "count"s << std::setw(width) << "total_ms"s << std::setw(width) << "mean_us"s
+           << std::setw(width) << "min_us"s << std::setw(width) << "p50_us"s << std::setw(width) << "p99_us"s
+           << std::setw(width) << "max_us"s << '\n';
+    output << std::fixed << std::setprecision(3);
+    for (auto& [path, scope_durations] : durations) {
+        std::sort(scope_durations.begin(), scope_durations.end());
+        int64_t total = 0;
+        for (const int64_t duration : scope_durations) {
+            total += duration;
+        }
+        const auto percentile = [&scope_durations](double percent) {
+            const size_t rank = static_cast<size_t>(percent / 100 * (scope_durations.size() - 1) + 0.5);
+            return ToMicroseconds(scope_durations[rank]);
+        };
+        output << std::left << std::setw(40) << std::string(2 * (path.size() - 1), ' ').append(path.back()) << std::right
+               << std::setw(10) << scope_durations.size()
+               << std::setw(width) << total / 1e6
+               << std::setw(width) << ToMicroseconds(total) / scope_durations.size()
+               << std::setw(width) << ToMicroseconds(scope_durations.front())
+               << std::setw(width) << percentile(50)
+               << std::setw(width) << percentile(99)
+               << std::setw(width) << ToMicroseconds(scope_durations.back()) << '\n';
+    }
+    if (lost_count > 0) {
+        output << lost_count << " scopes lost: thread buffers are full\n"s;
+    }
+    output.flags(flags);
+}
+
+void Profiler::WriteChromeTrace(std::ostream& output) const {
+    const auto flags = output.flags();
+    output << std::fixed << std::setprecision(3);
+    output << "{\"traceEvents\":[";
+    bool is_first = true;
+    for (const auto& [thread_index, events] : CopyEvents()) {
+        for (const Event& event : events) {
+            output << (is_first ? "\n" : ",\n") << "{\"name\":";
+            WriteJsonString(output, event.name);
+            output << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_index
+                   << ",\"ts\":" << ToMicroseconds(event.start_ns)
+                   << ",\"dur\":" << ToMicroseconds(event.duration_ns) << '}';
+            is_first = false;
+        }
+    }
+    output << "\n]}\n";
+    output.flags(flags);
+}
+
+void Profiler::Reset() {
+    std::lock_guard guard(mutex_);
+    for (const auto& buffer : buffers_) {
+        std::lock_guard buffer_guard(buffer->mutex);
+        buffer->events.clear();
+        buffer->lost_count = 0;
+    }
+}
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer() {
+    // Буферы живут, пока жив профилировщик, даже если их поток завершился
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard guard(mutex_);
+        buffers_.push_back(std::make_unique<ThreadBuffer>());
+        buffers_.back()->thread_index = static_cast<uint32_t>(buffers_.size() - 1);
+        buffer = buffers_.back().get();
+    }
+    return *buffer;
+}
+
+std::string_view Profiler::InternName(ThreadBuffer& buffer, std::string_view name) {
+    if (const auto it = buffer.names.find(name); it != buffer.names.end()) {
+        return it->second;
+    }
+    std::string_view interned;
+    {
+        std::lock_guard guard(mutex_);
+        interned = *names_.emplace(name).first;
+    }
+    buffer.names.emplace(interned, interned);
+    return interned;
+}
+
+void Profiler::Record(ThreadBuffer& buffer, const Event& event) {
+    std::lock_guard guard(buffer.mutex);
+    if (buffer.events.size() < PROFILER_MAX_EVENTS_PER_THREAD) {
+        buffer.events.push_back(event);
+    } else {
+        ++buffer.lost_count;
+    }
+}
+
+std::vector<std::pair<uint32_t, std::vector<Profiler::Event>>> Profiler::CopyEvents() const {
+    std::vector<std::pair<uint32_t, std::vector<Event>>> events;
+    std::lock_guard guard(mutex_);
+    for (const auto& buffer : buffers_) {
+        std::lock_guard buffer_guard(buffer->mutex);
+        events.emplace_back(buffer->thread_index, std::vector<Event>(buffer->events.begin(), buffer->events.end()));
+    }
+    return events;
+}
+
+ProfileScope::ProfileScope(std::string_view name)
+    : buffer_(Profiler::Instance().GetThreadBuffer())
+    , name_(Profiler::Instance().InternName(buffer_, name))
+    , id_(buffer_.next_id++)
+    , parent_(buffer_.current)
+    , start_(Profiler::Clock::now()) {
+    buffer_.current = id_;
+}
+
+ProfileScope::~ProfileScope() {
+    const Profiler::Clock::time_point finish = Profiler::Clock::now();
+    buffer_.current = parent_;
+    Profiler& profiler = Profiler::Instance();
+    profiler.Record(buffer_, {name_, id_, parent_,
+                              std::chrono::duration_cast<std::chrono::nanoseconds>(start_ - profiler.start_).count(),
+                              std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start_).count()});
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Сколько интервалов хранит один поток, следующие только учитываются как потерянные
+constexpr size_t PROFILER_MAX_EVENTS_PER_THREAD = size_t{1} << 20;
+
+// Иерархический профилировщик. Интервалы пишутся в буфер своего потока, родителем считается
+// интервал, открытый в том же потоке, поэтому работа, отданная другим потокам, попадает
+// в их корни. Отчёт и трасса собираются по требованию из буферов всех потоков
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Profiler& Instance();
+
+    // Сводка по путям вложенности: количество, сумма, минимум, максимум и перцентили в мкс
+    void PrintReport(std::ostream& output) const;
+    // Трасса в формате Chrome trace event (chrome://tracing, Perfetto)
+    void WriteChromeTrace(std::ostream& output) const;
+    void Reset();
+
+private:
+    friend class ProfileScope;
+
+    static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+    struct Event {
+        std::string_view name;
+        uint32_t id;
+        uint32_t parent;
+        int64_t start_ns;
+        int64_t duration_ns;
+    };
+
+    struct ThreadBuffer {
+        uint32_t thread_index = 0;
+        // Заполняется только своим потоком, mutex нужен для чтения отчёта
+        mutable std::mutex mutex;
+        // deque растёт без копирования накопленных событий
+        std::deque<Event> events;
+        size_t lost_count = 0;
+        // Открытый интервал потока и номер следующего
+        uint32_t current = NO_PARENT;
+        uint32_t next_id = 0;
+        // Имена, уже найденные потоком в names_
+        std::unordered_map<std::string_view, std::string_view> names;
+    };
+
+    const Clock::time_point start_ = Clock::now();
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    // Имена хранятся, пока жив профилировщик, события ссылаются на них
+    std::set<std::string, std::less<>> names_;
+
+    Profiler() = default;
+
+    ThreadBuffer& GetThreadBuffer();
+    std::string_view InternName(ThreadBuffer& buffer, std::string_view name);
+    void Record(ThreadBuffer& buffer, const Event& event);
+    std::vector<std::pair<uint32_t, std::vector<Event>>> CopyEvents() const;
+};
+
+// Интервал от создания до уничтожения. Имя копируется при первой встрече,
+// дальше запись интервала не выделяет память, пока буфер потока не растёт
+class ProfileScope {
+public:
+    explicit ProfileScope(std::string_view name);
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+    ~ProfileScope();
+
+private:
+    Profiler::ThreadBuffer& buffer_;
+    std::string_view name_;
+    uint32_t id_;
+    uint32_t parent_;
+    Profiler::Clock::time_point start_;
+};
@@ -0,0 +1,98 @@
+#include <atomic>
+
+#include "query_executor.h"
+#include "top_documents.h"
+
+using namespace std;
+
+struct QueryExecutor::QueryState {
+    std::string raw_query;
+    QueryOptions options;
+    std::chrono::steady_clock::time_point deadline;
+    std::promise<QueryResult> promise;
+
+    SearchServer::ScoringTerms terms;
+    size_t ordinal_count = 0;
+    // Лучшие документы каждого диапазона
+    std::vector<std::vector<Document>> range_documents;
+    std::atomic<size_t> remaining_ranges = 0;
+    std::atomic<bool> is_complete = true;
+};
+
+QueryExecutor::QueryExecutor(const SearchServer& search_server, size_t thread_count)
+    : search_server_(search_server)
+    , pool_(thread_count) {
+}
+
+std::future<QueryResult> QueryExecutor::Submit(std::string raw_query, QueryOptions options) {
+    using Clock = std::chrono::steady_clock;
+    auto state = std::make_shared<QueryState>();
+    state->raw_query = std::move(raw_query);
+    state->options = options;
+    state->deadline = options.timeout == Clock::duration::max()
+                      ? Clock::time_point::max()
+                      : Clock::now() + options.timeout;
+    auto result = state->promise.get_future();
+    pool_.Submit([this, state] {
+        StartQuery(state);
+    });
+    return result;
+}
+
+size_t QueryExecutor::GetThreadCount() const {
+    return pool_.GetThreadCount();
+}
+
+void QueryExecutor::StartQuery(const std::shared_ptr<QueryState>& state) {
+    try {
+        const auto query = search_server_.ParseQuery(std::execution::seq, state->raw_query);
+        state->terms = search_server_.PrepareScoringTerms(query);
+    } catch (...) {
+        state->promise.set_exception(std::current_exception());
+        return;
+    }
+    if (state->terms.plus_terms.empty()) {
+        state->promise.set_value({});
+        return;
+    }
+
+    state->ordinal_count = search_server_.GetOrdinalCount();
+    const size_t range_count = std::max<size_t>(1, (state->ordinal_count + QUERY_EXECUTOR_RANGE_SIZE - 1) / QUERY_EXECUTOR_RANGE_SIZE);
+    state->range_documents.resize(range_count);
+    state->remaining_ranges = range_count;
+    // Остальные диапазоны попадают в очередь этого потока, свободные потоки могут их перехватить
+    for (size_t range = 1; range < range_count; ++range) {
+        pool_.Submit([this, state, range] {
+            ScoreRange(state, range);
+        });
+    }
+    ScoreRange(state, 0);
+}
+
+void QueryExecutor::ScoreRange(const std::shared_ptr<QueryState>& state, size_t range) {
+    if (std::chrono::steady_clock::now() > state->deadline) {
+        state->is_complete = false;
+    } else {
+        const DocumentOrdinal first = static_cast<DocumentOrdinal>(range * QUERY_EXECUTOR_RANGE_SIZE);
+        const DocumentOrdinal last = static_cast<DocumentOrdinal>(std::min(state->ordinal_count, (range + 1) * QUERY_EXECUTOR_RANGE_SIZE));
+        const DocumentStatus status = state->options.status;
+        auto documents = search_server_.ScoreOrdinalRange(state->terms, [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, first, last);
+        SelectTopDocuments(documents, state->options.top_k);
+        state->range_documents[range] = std::move(documents);
+    }
+    if (state->remaining_ranges.fetch_sub(1) == 1) {
+        Finish(*state);
+    }
+}
+
+void QueryExecutor::Finish(QueryState& state) {
+    QueryResult result;
+    for (auto& documents : state.range_documents) {
+        result.documents.insert(result.documents.end(), documents.begin(), documents.end());
+    }
+    SelectTopDocuments(result.documents, state.options.top_k);
+    result.is_complete = state.is_complete;
+    state.promise.set_value(std::move(result));
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+// Сколько документов оценивает одна задача запроса. Задачи одного запроса выполняются
+// на том же пуле, что и остальные запросы, и проверяют срок перед началом
+constexpr size_t QUERY_EXECUTOR_RANGE_SIZE = 2048;
+
+struct QueryOptions {
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    size_t top_k = MAX_RESULT_DOCUMENT_COUNT;
+    // Время на запрос с момента Submit, по умолчанию не ограничено
+    std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max();
+};
+
+struct QueryResult {
+    std::vector<Document> documents;
+    // false, если срок истёк раньше, чем были оценены все документы.
+    // Тогда documents — лучшие среди оценённых
+    bool is_complete = true;
+};
+
+// Выполняет запросы к SearchServer на собственном пуле потоков с перехватом задач.
+// Сервер не должен меняться, пока исполнитель жив
+class QueryExecutor {
+public:
+    explicit QueryExecutor(const SearchServer& search_server, size_t thread_count = std::thread::hardware_concurrency());
+
+    // Ошибка разбора запроса передаётся через future
+    std::future<QueryResult> Submit(std::string raw_query, QueryOptions options = {});
+
+    size_t GetThreadCount() const;
+
+private:
+    struct QueryState;
+
+    const SearchServer& search_server_;
+    // Пул объявлен последним: его деструктор дожидается задач, которые обращаются к остальным полям
+    ThreadPool pool_;
+
+    void StartQuery(const std::shared_ptr<QueryState>& state);
+    void ScoreRange(const std::shared_ptr<QueryState>& state, size_t range);
+    static void Finish(QueryState& state);
+};
@@ -0,0 +1,86 @@
+#include "query_result_cache.h"
+
+using namespace std;
+
+void QueryResultCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    for (Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        shard.positions.clear();
+        shard.entries.clear();
+        shard.bytes = 0;
+    }
+}
+
+bool QueryResultCache::IsEnabled() const {
+    return capacity_ > 0;
+}
+
+void QueryResultCache::Invalidate() {
+    ++epoch_;
+}
+
+std::optional<std::vector<Document>> QueryResultCache::Find(const std::string& key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto position = shard.positions.find(key);
+    if (position == shard.positions.end()) {
+        ++shard.misses;
+        return std::nullopt;
+    }
+    const auto it = position->second;
+    if (it->epoch != epoch_) {
+        EraseEntry(shard, it);
+        ++shard.misses;
+        return std::nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it);
+    ++shard.hits;
+    return it->documents;
+}
+
+void QueryResultCache::Insert(std::string key, std::vector<Document> documents) {
+    const size_t shard_capacity = capacity_ / shards_.size();
+    const size_t bytes = sizeof(Entry) + key.size() + documents.size() * sizeof(Document)
+                         + sizeof(std::pair<std::string_view, std::list<Entry>::iterator>);
+    if (bytes > shard_capacity) {
+        return;
+    }
+
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    // Ключ мог вставить другой поток, пока результат вычислялся
+    if (const auto position = shard.positions.find(key); position != shard.positions.end()) {
+        EraseEntry(shard, position->second);
+    }
+    while (!shard.entries.empty() && shard.bytes + bytes > shard_capacity) {
+        EraseEntry(shard, std::prev(shard.entries.end()));
+        ++shard.evictions;
+    }
+    shard.entries.push_front({std::move(key), std::move(documents), epoch_, bytes});
+    shard.positions.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.bytes += bytes;
+}
+
+QueryResultCacheStats QueryResultCache::GetStats() const {
+    QueryResultCacheStats stats;
+    for (const Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.entry_count += shard.entries.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
+
+void QueryResultCache::EraseEntry(Shard& shard, std::list<Entry>::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.positions.erase(it->key);
+    shard.entries.erase(it);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+// Число независимых частей кэша, у каждой свой мьютекс и свой список LRU
+constexpr size_t QUERY_RESULT_CACHE_SHARD_COUNT = 16;
+
+struct QueryResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entry_count = 0;
+    size_t bytes = 0;
+};
+
+// Результаты запросов по нормализованному ключу с вытеснением давно не использованных (LRU).
+// Память ограничена capacity байт (оценка: ключ, документы и служебные данные записи).
+// Invalidate начинает новую эпоху индекса, записи прошлых эпох считаются промахом
+// и удаляются при обращении или вытесняются.
+// Find и Insert можно вызывать из нескольких потоков одновременно.
+class QueryResultCache {
+public:
+    QueryResultCache() = default;
+    // Копия получает ту же ёмкость, но пустая
+    QueryResultCache(const QueryResultCache& other)
+        : capacity_(other.capacity_) {
+    }
+    QueryResultCache& operator=(const QueryResultCache&) = delete;
+
+    // 0 выключает кэш. Текущие записи удаляются
+    void SetCapacity(size_t capacity);
+    bool IsEnabled() const;
+
+    void Invalidate();
+
+    std::optional<std::vector<Document>> Find(const std::string& key);
+    void Insert(std::string key, std::vector<Document> documents);
+
+    QueryResultCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<Document> documents;
+        uint64_t epoch = 0;
+        size_t bytes = 0;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // Начало списка — последние использованные записи
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> positions;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    std::vector<Shard> shards_ = std::vector<Shard>(QUERY_RESULT_CACHE_SHARD_COUNT);
+    size_t capacity_ = 0;
+    uint64_t epoch_ = 0;
+
+    Shard& GetShard(const std::string& key);
+    static void EraseEntry(Shard& shard, std::list<Entry>::iterator it);
+};
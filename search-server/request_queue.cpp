@@ -1,22 +1,155 @@
+#include <stdexcept>
+
 #include "request_queue.h"
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server) : server_(search_server) {
-    no_result_requests_count_ = 0;
+RequestQueue::RequestQueue(const SearchServer& search_server, Clock::duration window, size_t slot_count,
+                           Clock::duration stats_window, size_t stats_slot_count)
+    : server_(search_server)
+    , slot_duration_(slot_count > 0 ? window / static_cast<Clock::rep>(slot_count) : Clock::duration::zero())
+    , slots_(slot_count)
+    , stats_slot_duration_(stats_slot_count > 0 ? stats_window / static_cast<Clock::rep>(stats_slot_count) : Clock::duration::zero())
+    , stats_buffers_(2 * stats_slot_count)
+    , stats_slots_(stats_slot_count) {
+    if (slot_duration_ <= Clock::duration::zero() || stats_slot_duration_ <= Clock::duration::zero()) {
+        throw std::invalid_argument("Request window is shorter than slot count"s);
+    }
+    for (size_t i = 0; i < stats_slots_.size(); ++i) {
+        stats_slots_[i].current.store(&stats_buffers_[2 * i], std::memory_order_relaxed);
+        stats_slots_[i].spare.store(&stats_buffers_[2 * i + 1], std::memory_order_relaxed);
+    }
 }
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus status) {
     return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating){
         return status == document_status;
     });
 }
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query) {
     return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return no_result_requests_count_;
+    return CountInWindow(&Slot::no_result_requests);
+}
+
+int RequestQueue::GetRequestCount() const {
+    return CountInWindow(&Slot::requests);
+}
+
+RequestQueueStats RequestQueue::GetStats() const {
+    const Clock::time_point now = Clock::now();
+    const uint64_t period = (now - start_) / stats_slot_duration_;
+    RequestQueueStats stats;
+    for (const StatsSlot& slot : stats_slots_) {
+        const StatsBuffer& buffer = *slot.current.load(std::memory_order_acquire);
+        const uint64_t buffer_period = buffer.period.load(std::memory_order_acquire);
+        if (buffer_period > period || period - buffer_period >= stats_slots_.size()) {
+            continue;
+        }
+        const HistogramSnapshot latencies = buffer.latencies.GetSnapshot();
+        const HistogramSnapshot result_counts = buffer.result_counts.GetSnapshot();
+        // Буфер сменили и очистили, пока копировали: его данные вне окна
+        if (buffer.period.load(std::memory_order_acquire) != buffer_period) {
+            continue;
+        }
+        stats.latencies.Merge(latencies);
+        stats.result_counts.Merge(result_counts);
+    }
+
+    const uint64_t first_period = period + 1 >= stats_slots_.size() ? period + 1 - stats_slots_.size() : 0;
+    stats.window = std::chrono::duration_cast<std::chrono::nanoseconds>(now - (start_ + first_period * stats_slot_duration_));
+    stats.request_count = stats.latencies.count;
+    if (stats.window.count() > 0) {
+        stats.requests_per_second = stats.request_count / std::chrono::duration<double>(stats.window).count();
+    }
+    stats.latency_p50 = std::chrono::nanoseconds(stats.latencies.GetPercentile(50));
+    stats.latency_p90 = std::chrono::nanoseconds(stats.latencies.GetPercentile(90));
+    stats.latency_p99 = std::chrono::nanoseconds(stats.latencies.GetPercentile(99));
+    stats.latency_p999 = std::chrono::nanoseconds(stats.latencies.GetPercentile(99.9));
+    return stats;
+}
+
+void RequestQueue::AddRequest(Clock::time_point time, Clock::duration latency, size_t result_count) {
+    const uint32_t period = GetPeriod(time);
+    Slot& slot = slots_[period % slots_.size()];
+    Increment(slot.requests, period);
+    if (result_count == 0) {
+        Increment(slot.no_result_requests, period);
+    }
+    RecordStats(time, latency, result_count);
 }
 
+void RequestQueue::RecordStats(Clock::time_point time, Clock::duration latency, size_t result_count) {
+    const uint64_t period = (time - start_) / stats_slot_duration_;
+    StatsSlot& slot = stats_slots_[period % stats_slots_.size()];
+    StatsBuffer* buffer = slot.current.load(std::memory_order_acquire);
+    for (;;) {
+        const uint64_t buffer_period = buffer->period.load(std::memory_order_acquire);
+        if (buffer_period == STATS_BUFFER_RESETTING) {
+            // Буфер уже сменили и очищают, текущий — другой
+            buffer = slot.current.load(std::memory_order_acquire);
+            continue;
+        }
+        if (buffer_period >= period) {
+            // Запрос, опоздавший к уже начавшемуся следующему периоду, учитывается в нём
+            break;
+        }
+        StatsBuffer* fresh = slot.spare.exchange(nullptr, std::memory_order_acquire);
+        if (!fresh) {
+            // Буфер как раз меняет другой запрос. Ждать его не нужно: запись уходит в текущий
+            // буфер и теряется, только если смена ещё не завершилась
+            buffer = slot.current.load(std::memory_order_acquire);
+            break;
+        }
+        fresh->period.store(period, std::memory_order_relaxed);
+        if (!slot.current.compare_exchange_strong(buffer, fresh, std::memory_order_acq_rel)) {
+            // Буфер уже сменили, запасной возвращается на место, buffer теперь текущий
+            slot.spare.store(fresh, std::memory_order_release);
+            continue;
+        }
+        // Старые данные вне окна: записи опоздавших в них запросов теряются вместе с ними
+        buffer->period.store(STATS_BUFFER_RESETTING, std::memory_order_release);
+        buffer->latencies.Reset();
+        buffer->result_counts.Reset();
+        slot.spare.store(buffer, std::memory_order_release);
+        buffer = fresh;
+        break;
+    }
+    buffer->latencies.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    buffer->result_counts.Record(result_count);
+}
+
+uint32_t RequestQueue::GetPeriod(Clock::time_point time) const {
+    // Номера периодов сравниваются по модулю 2^32, переполнение не мешает
+    return static_cast<uint32_t>((time - start_) / slot_duration_);
+}
+
+void RequestQueue::Increment(std::atomic<uint64_t>& counter, uint32_t period) {
+    uint64_t value = counter.load(std::memory_order_relaxed);
+    uint64_t desired;
+    do {
+        const uint32_t slot_period = static_cast<uint32_t>(value >> 32);
+        // Запрос, опоздавший к уже начавшемуся следующему периоду, учитывается в нём
+        if (slot_period == period || static_cast<int32_t>(slot_period - period) > 0) {
+            desired = value + 1;
+        } else {
+            desired = (static_cast<uint64_t>(period) << 32) | 1;
+        }
+    } while (!counter.compare_exchange_weak(value, desired, std::memory_order_relaxed));
+}
+
+int RequestQueue::CountInWindow(std::atomic<uint64_t> Slot::* counter) const {
+    const uint32_t period = GetPeriod(Clock::now());
+    uint64_t count = 0;
+    for (const Slot& slot : slots_) {
+        const uint64_t value = (slot.*counter).load(std::memory_order_relaxed);
+        // Слоты старше окна и слоты, начатые позже period, не учитываются
+        if (period - static_cast<uint32_t>(value >> 32) < slots_.size()) {
+            count += value & 0xFFFFFFFFu;
+        }
+    }
+    return static_cast<int>(count);
+}
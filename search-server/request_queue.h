@@ -1,57 +1,107 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string_view>
 #include <vector>
-#include <string>
-#include <deque>
-#include <stdexcept>
+
+#include "histogram.h"
 #include "search_server.h"
 #include "document.h"
 
+// По умолчанию статистика ведётся за последние сутки с точностью до минуты
+constexpr std::chrono::steady_clock::duration REQUEST_QUEUE_WINDOW = std::chrono::hours(24);
+constexpr size_t REQUEST_QUEUE_SLOT_COUNT = 1440;
+// Задержки и размеры выдачи — за последнюю минуту: два набора гистограмм слота занимают около 36 КБ
+constexpr std::chrono::steady_clock::duration REQUEST_QUEUE_STATS_WINDOW = std::chrono::minutes(1);
+constexpr size_t REQUEST_QUEUE_STATS_SLOT_COUNT = 12;
+
+struct RequestQueueStats {
+    // Время, за которое собрана статистика: окно или меньше, если очередь создана недавно
+    std::chrono::nanoseconds window{};
+    uint64_t request_count = 0;
+    double requests_per_second = 0;
+    std::chrono::nanoseconds latency_p50{};
+    std::chrono::nanoseconds latency_p90{};
+    std::chrono::nanoseconds latency_p99{};
+    std::chrono::nanoseconds latency_p999{};
+    // Задержки FindTopDocuments в наносекундах и число документов в выдаче
+    HistogramSnapshot latencies;
+    HistogramSnapshot result_counts;
+};
+
+// Статистика запросов за скользящее окно времени. Окно делится на слоты кольцевого буфера
+// фиксированного размера, запрос только увеличивает счётчики своего слота, поэтому память
+// не зависит от числа запросов. Граница окна округляется до слота: самый старый слот
+// учитывается целиком. AddFindRequest можно вызывать из нескольких потоков одновременно.
+// Задержки и размеры выдачи собираются так же, но в отдельное окно stats_window
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    using Clock = std::chrono::steady_clock;
+
+    explicit RequestQueue(const SearchServer& search_server, Clock::duration window = REQUEST_QUEUE_WINDOW,
+                          size_t slot_count = REQUEST_QUEUE_SLOT_COUNT,
+                          Clock::duration stats_window = REQUEST_QUEUE_STATS_WINDOW,
+                          size_t stats_slot_count = REQUEST_QUEUE_STATS_SLOT_COUNT);
+
     template <typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
+    std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate);
 
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
+    std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentStatus status);
 
-    std::vector<Document> AddFindRequest(const std::string& raw_query);
+    std::vector<Document> AddFindRequest(std::string_view raw_query);
 
+    // Число запросов за окно, заканчивающееся сейчас
     int GetNoResultRequests() const;
+    int GetRequestCount() const;
+    // Копирует гистограммы слотов окна, запросы при этом не блокируются
+    RequestQueueStats GetStats() const;
+
 private:
-    struct QueryResult {
-        std::vector<Document> document_results_;
-        bool no_result;
+    // В старших 32 битах счётчика — номер периода слота, в младших — число запросов за период.
+    // Первый запрос нового периода заменяет значение целиком, так что сброс слота не теряет запросов
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> requests = 0;
+        std::atomic<uint64_t> no_result_requests = 0;
+    };
+
+    struct StatsBuffer {
+        // Номер периода гистограмм или STATS_BUFFER_RESETTING, пока они очищаются
+        std::atomic<uint64_t> period = 0;
+        Histogram latencies;
+        Histogram result_counts;
+    };
+    static constexpr uint64_t STATS_BUFFER_RESETTING = std::numeric_limits<uint64_t>::max();
+
+    // У слота два буфера: текущий и заранее очищенный запасной. Первый запрос нового периода
+    // подменяет текущий запасным и очищает старый, остальные запросы при этом не ждут
+    struct StatsSlot {
+        std::atomic<StatsBuffer*> current = nullptr;
+        std::atomic<StatsBuffer*> spare = nullptr;
     };
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
-    int no_result_requests_count_;
 
     const SearchServer& server_;
+    const Clock::time_point start_ = Clock::now();
+    const Clock::duration slot_duration_;
+    std::vector<Slot> slots_;
+    const Clock::duration stats_slot_duration_;
+    std::vector<StatsBuffer> stats_buffers_;
+    std::vector<StatsSlot> stats_slots_;
+
+    void AddRequest(Clock::time_point time, Clock::duration latency, size_t result_count);
+    void RecordStats(Clock::time_point time, Clock::duration latency, size_t result_count);
+    uint32_t GetPeriod(Clock::time_point time) const;
+    static void Increment(std::atomic<uint64_t>& counter, uint32_t period);
+    int CountInWindow(std::atomic<uint64_t> Slot::* counter) const;
 };
 
 template <typename DocumentPredicate>
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate) {
+    const Clock::time_point start = Clock::now();
     std::vector<Document> result = server_.FindTopDocuments(raw_query, document_predicate);
-    QueryResult query_result = {result, result.empty() ? true : false};
-    if(requests_.size() < min_in_day_) {
-        if(query_result.no_result) {
-            ++no_result_requests_count_;
-        }
-        requests_.push_back(query_result);
-    }
-    else {
-        if(requests_.front().no_result) {
-            --no_result_requests_count_;
-        }
-        requests_.pop_front();
-        if(query_result.no_result) {
-            ++no_result_requests_count_;
-        }
-        requests_.push_back(query_result);
-    }
-
+    const Clock::time_point finish = Clock::now();
+    AddRequest(finish, finish - start, result.size());
     return result;
 }
-
@@ -10,32 +10,54 @@ void SearchServer::AddDocument(int document_id,
                    DocumentStatus status,
                    const std::vector<int>& ratings) {
     if ((document_id < 0) ||
-        (documents_.count(document_id) > 0)) {
+        (document_ordinals_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id");
     }
 
     const auto words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
 
+    std::vector<TermId> terms;
+    terms.reserve(words.size());
     for (const auto word : words) {
-        auto it = words_.insert(std::string(word));
-        std::string_view sv_word = *(it.first);
-        word_to_document_freqs_[sv_word][document_id]
-            += inv_word_count;
-        documents_words_freqs_[document_id][sv_word]
-            += inv_word_count;
+        terms.push_back(dictionary_.Intern(word));
     }
 
-    documents_.emplace(document_id,
-                       DocumentData
-                       {ComputeAverageRating(ratings), status});
+    const DocumentOrdinal ordinal = static_cast<DocumentOrdinal>(document_ids_.size());
+    auto term_freqs = ComputeTermFreqs(std::move(terms));
+    for (const auto [term, freq] : term_freqs) {
+        index_.AddPosting(term, ordinal, freq);
+    }
+    index_.CompactIfNeeded();
+
+    AppendDocument(document_id, status, ratings, std::move(term_freqs));
+}
+
+void SearchServer::AddDocuments(const std::vector<DocumentInput>& documents) {
+    AddDocuments(std::execution::seq, documents);
+}
+
+void SearchServer::AppendDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings,
+                                  std::vector<TermFreq> term_freqs) {
+    const DocumentOrdinal ordinal = static_cast<DocumentOrdinal>(document_ids_.size());
+    document_ordinals_.emplace_hint(document_ordinals_.end(), document_id, ordinal);
+    document_ids_.push_back(document_id);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    document_statuses_.push_back(status);
+    document_terms_.AddDocument(std::move(term_freqs));
+    InvalidateCaches();
+}
 
-    document_ids_.emplace(document_id);
+void SearchServer::InvalidateCaches() {
+    inverse_document_freqs_.Invalidate(dictionary_.GetTermCount());
+    query_results_.Invalidate();
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k, RetrievalMode mode) const {
+    PROFILE_SCOPE("FindTopDocuments");
+    return FindTopDocumentsCached(std::execution::seq, raw_query, status, top_k, mode, [&](const Query& query) {
+        return FindTopDocumentsByQuery(query, [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, top_k, mode);
     });
 }
 
@@ -44,50 +66,42 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ordinals_.size();
 }
 
 // MatchDocument
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
-        throw std::out_of_range("document_id out of range"s);
-    }
-
-    const auto& word_freqs = documents_words_freqs_.at(document_id);
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
     const auto& query = ParseQuery(std::execution::seq, raw_query);
 
     for (const std::string_view word : query.minus_words) {
-        if (word_freqs.count(word) > 0) {
-            return { empty_vector, documents_.at(document_id).status };
+        if (HasTerm(ordinal, word)) {
+            return { empty_vector, document_statuses_[ordinal] };
         }
     }
 
     std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.plus_words) {
-        if (word_freqs.count(word) > 0) {
+        if (HasTerm(ordinal, word)) {
             matched_words.push_back(word);
         }
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_statuses_[ordinal] };
 }
 
 // MatchDocument sequenced_policy
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument( const std::execution::sequenced_policy& policy, const std::string_view raw_query, int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
-        throw std::out_of_range("document_id out of range"s);
-    }
-
-    const auto& word_freqs = documents_words_freqs_.at(document_id);
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
     const auto& query = ParseQuery(policy, raw_query);
 
     if (std::any_of(policy,
                     query.minus_words.begin(),
                     query.minus_words.end(),
-                    [&word_freqs](const std::string_view word) {
-                        return word_freqs.count(word) > 0;
+                    [this, ordinal](const std::string_view word) {
+                        return HasTerm(ordinal, word);
                     })) {
-        return { empty_vector, documents_.at(document_id).status };
+        return { empty_vector, document_statuses_[ordinal] };
     }
 
     std::vector<std::string_view> matched_words;
@@ -96,29 +110,25 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
                  query.plus_words.begin(),
                  query.plus_words.end(),
                  std::back_inserter(matched_words),
-                 [&word_freqs](const std::string_view word) {
-                     return word_freqs.count(word) > 0;
+                 [this, ordinal](const std::string_view word) {
+                     return HasTerm(ordinal, word);
                  });
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_statuses_[ordinal] };
 }
 
 // MatchDocument parallel_policy
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument( const std::execution::parallel_policy& policy, const std::string_view raw_query, int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
-        throw std::out_of_range("document_id out of range"s);
-    }
-
-    const auto& word_freqs = documents_words_freqs_.at(document_id);
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
     const auto& query = ParseQuery(policy, raw_query, false);
 
     if (std::any_of(//policy,
                     query.minus_words.begin(),
                     query.minus_words.end(),
-                    [&word_freqs](const std::string_view word) {
-                        return word_freqs.count(word) > 0;
+                    [this, ordinal](const std::string_view word) {
+                        return HasTerm(ordinal, word);
                     })) {
-        return { empty_vector, documents_.at(document_id).status };
+        return { empty_vector, document_statuses_[ordinal] };
     }
 
     std::vector<std::string_view> matched_words;
@@ -127,8 +137,8 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
                  query.plus_words.begin(),
                  query.plus_words.end(),
                  std::back_inserter(matched_words),
-                 [&word_freqs](const std::string_view word) {
-                     return word_freqs.count(word) > 0;
+                 [this, ordinal](const std::string_view word) {
+                     return HasTerm(ordinal, word);
                  });
 
     std::sort(policy,
@@ -139,7 +149,7 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
                           matched_words.end());
     matched_words.erase(it, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_statuses_[ordinal] };
 }
 
 // RemoveDocument
@@ -147,8 +157,137 @@ void SearchServer::RemoveDocument(int document_id) {
     RemoveDocument(std::execution::seq, document_id);
 }
 
+void SearchServer::SaveIndex(const std::string& path) const {
+    IndexFileWriter writer(path);
+    writer.WriteStrings({stop_words_.begin(), stop_words_.end()});
+
+    std::vector<std::string_view> words;
+    words.reserve(dictionary_.GetTermCount());
+    for (TermId term = 0; term < dictionary_.GetTermCount(); ++term) {
+        words.push_back(dictionary_.GetWord(term));
+    }
+    writer.WriteStrings(words);
+
+    // Удалённые документы не сохраняются, живые получают номера подряд
+    const std::vector<DocumentOrdinal> new_ordinals = MakeLiveOrdinals();
+    const size_t ordinal_count = document_ordinals_.size();
+    std::vector<int> ids;
+    std::vector<int> ratings;
+    std::vector<DocumentStatus> statuses;
+    ids.reserve(ordinal_count);
+    ratings.reserve(ordinal_count);
+    statuses.reserve(ordinal_count);
+    for (DocumentOrdinal ordinal = 0; ordinal < GetOrdinalCount(); ++ordinal) {
+        if (new_ordinals[ordinal] != NO_ORDINAL) {
+            ids.push_back(document_ids_[ordinal]);
+            ratings.push_back(document_ratings_[ordinal]);
+            statuses.push_back(document_statuses_[ordinal]);
+        }
+    }
+    writer.Write<uint64_t>(ordinal_count);
+    writer.WriteArray(ids.data(), ordinal_count);
+    writer.WriteArray(ratings.data(), ordinal_count);
+    writer.WriteArray(statuses.data(), ordinal_count);
+
+    std::vector<DocumentOrdinal> live_ordinals;
+    live_ordinals.reserve(ordinal_count);
+    for (const auto [document_id, ordinal] : document_ordinals_) {
+        live_ordinals.push_back(new_ordinals[ordinal]);
+    }
+    writer.Write<uint64_t>(live_ordinals.size());
+    writer.WriteArray(live_ordinals.data(), live_ordinals.size());
+
+    document_terms_.Save(writer, new_ordinals);
+    index_.Save(writer, new_ordinals);
+    writer.Finish();
+}
+
+SearchServer SearchServer::LoadIndex(const std::string& path) {
+    IndexFileReader reader(path);
+    SearchServer search_server(reader.ReadStrings());
+
+    const auto words = reader.ReadStrings();
+    for (size_t term = 0; term < words.size(); ++term) {
+        if (search_server.dictionary_.Intern(words[term]) != term) {
+            throw std::invalid_argument("Invalid index file dictionary"s);
+        }
+    }
+
+    const auto ordinal_count = reader.Read<uint64_t>();
+    const int* ids = reader.ReadArray<int>(ordinal_count);
+    const int* ratings = reader.ReadArray<int>(ordinal_count);
+    const DocumentStatus* statuses = reader.ReadArray<DocumentStatus>(ordinal_count);
+    search_server.document_ids_.assign(ids, ids + ordinal_count);
+    search_server.document_ratings_.assign(ratings, ratings + ordinal_count);
+    search_server.document_statuses_.assign(statuses, statuses + ordinal_count);
+
+    // Живые номера записаны в порядке возрастания id
+    const auto live_count = reader.Read<uint64_t>();
+    const DocumentOrdinal* live_ordinals = reader.ReadArray<DocumentOrdinal>(live_count);
+    for (uint64_t i = 0; i < live_count; ++i) {
+        const DocumentOrdinal ordinal = live_ordinals[i];
+        if (ordinal >= ordinal_count
+            || (i > 0 && ids[live_ordinals[i - 1]] >= ids[ordinal])) {
+            throw std::invalid_argument("Invalid index file documents"s);
+        }
+        search_server.document_ordinals_.emplace_hint(search_server.document_ordinals_.end(), ids[ordinal], ordinal);
+    }
+
+    search_server.document_terms_.Load(reader, ordinal_count, words.size());
+    search_server.index_.Load(reader, words.size(), ordinal_count);
+    search_server.InvalidateCaches();
+    return search_server;
+}
+
+void SearchServer::SetPostingEncoding(PostingEncoding encoding) {
+    index_.SetEncoding(encoding);
+    // Сжатие частот может округлить релевантность
+    query_results_.Invalidate();
+}
+
+IndexMemoryUsage SearchServer::GetIndexMemoryUsage() const {
+    return index_.GetMemoryUsage();
+}
+
+InverseDocumentFreqCacheStats SearchServer::GetInverseDocumentFreqCacheStats() const {
+    return inverse_document_freqs_.GetStats();
+}
+
+void SearchServer::SetQueryResultCacheCapacity(size_t capacity) {
+    query_results_.SetCapacity(capacity);
+}
+
+QueryResultCacheStats SearchServer::GetQueryResultCacheStats() const {
+    return query_results_.GetStats();
+}
+
+void SearchServer::SetAutoStopWords(double max_document_share, int min_document_count) {
+    auto_stop_word_share_ = max_document_share;
+    auto_stop_word_min_document_count_ = min_document_count;
+    query_results_.Invalidate();
+}
+
+std::vector<std::pair<std::string_view, size_t>> SearchServer::GetAutoStopWords() const {
+    std::vector<std::pair<std::string_view, size_t>> words;
+    for (TermId term = 0; term < dictionary_.GetTermCount(); ++term) {
+        if (IsAutoStopTerm(term)) {
+            words.emplace_back(dictionary_.GetWord(term), index_.GetDocumentFreq(term));
+        }
+    }
+    std::sort(words.begin(), words.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second > rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+    });
+    return words;
+}
+
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
+}
+
+bool SearchServer::IsAutoStopTerm(TermId term) const {
+    const int document_count = GetDocumentCount();
+    return auto_stop_word_share_ < 1.0 && document_count >= auto_stop_word_min_document_count_
+           && index_.GetDocumentFreq(term) > auto_stop_word_share_ * document_count;
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -159,14 +298,14 @@ bool SearchServer::IsValidWord(const std::string_view word) {
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
     std::vector<std::string_view> words;
-    for (const std::string_view& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
+    ForEachWord(text, [this, &words](std::string_view word, bool has_control) {
+        if (has_control) {
             throw invalid_argument("Word "s + std::string(word) + " is invalid"s);
         }
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
-    }
+    });
     return words;
 }
 
@@ -178,7 +317,39 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text) const {
+std::vector<TermFreq> SearchServer::ComputeTermFreqs(std::vector<TermId> terms) {
+    const double inv_word_count = 1.0 / terms.size();
+    std::sort(terms.begin(), terms.end());
+
+    // Частоты накапливаются сложением, а не умножением, чтобы значения
+    // не отличались от прежней реализации ни в одном бите
+    std::vector<TermFreq> term_freqs;
+    for (const TermId term : terms) {
+        if (term_freqs.empty() || term_freqs.back().term != term) {
+            term_freqs.push_back({term, 0.0});
+        }
+        term_freqs.back().freq += inv_word_count;
+    }
+    return term_freqs;
+}
+
+std::string SearchServer::MakeQueryResultKey(const Query& query, DocumentStatus status, size_t top_k,
+                                             RetrievalMode mode, bool is_parallel) {
+    // Слова не содержат пробелов и не начинаются с '-', поэтому ключ однозначен
+    std::string key = std::to_string(static_cast<int>(status)) + ' ' + std::to_string(top_k) + ' '
+                      + std::to_string(static_cast<int>(mode)) + (is_parallel ? 'p' : 's');
+    for (const std::string_view word : query.plus_words) {
+        key += ' ';
+        key += word;
+    }
+    for (const std::string_view word : query.minus_words) {
+        key += " -"s;
+        key += word;
+    }
+    return key;
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text, bool has_control) const {
     if (text.empty()) {
         throw std::invalid_argument("Query word is empty"s);
     }
@@ -188,22 +359,174 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+    if (word.empty() || word[0] == '-' || has_control) {
         throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
 
-    return {word, is_minus, IsStopWord(word)};
+    bool is_stop = IsStopWord(word);
+    // Минус-слова не пропускаются: исключение документов задаёт пользователь
+    if (!is_stop && !is_minus && auto_stop_word_share_ < 1.0) {
+        const TermId term = dictionary_.Find(word);
+        is_stop = term != NO_TERM && IsAutoStopTerm(term);
+    }
+    return {word, is_minus, is_stop};
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term) const {
+    return inverse_document_freqs_.Get(term, [this](TermId term) {
+        return ComputeTermInverseDocumentFreq(term);
+    });
+}
+
+double SearchServer::ComputeTermInverseDocumentFreq(TermId term) const {
+    return ComputeInverseDocumentFreq(GetDocumentCount(), index_.GetDocumentFreq(term));
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::ComputeInverseDocumentFreq(int document_count, size_t document_freq) {
+    return std::log(document_count * 1.0 / document_freq);
+}
+
+size_t SearchServer::GetDocumentFreq(const std::string_view word) const {
+    const TermId term = dictionary_.Find(word);
+    return term == NO_TERM ? 0 : index_.GetDocumentFreq(term);
+}
+
+void SearchServer::RangeScores::Reset() {
+    if (IsDense()) {
+        std::fill(relevances.begin(), relevances.begin() + range_size, 0.0);
+        std::fill(states.begin(), states.begin() + range_size, ScoringState::UNMATCHED);
+    } else {
+        for (const DocumentOrdinal offset : touched) {
+            relevances[offset] = 0.0;
+            states[offset] = ScoringState::UNMATCHED;
+        }
+    }
+    touched.clear();
+}
+
+SearchServer::ThreadRangeScores::ThreadRangeScores(size_t range_size) {
+    auto& pool = GetPool();
+    if (pool.empty()) {
+        scores_ = std::make_unique<RangeScores>();
+    } else {
+        scores_ = std::move(pool.back());
+        pool.pop_back();
+    }
+    if (scores_->relevances.size() < range_size) {
+        scores_->relevances.resize(range_size, 0.0);
+        scores_->states.resize(range_size, ScoringState::UNMATCHED);
+    }
+    scores_->range_size = range_size;
+}
+
+SearchServer::ThreadRangeScores::~ThreadRangeScores() {
+    scores_->Reset();
+    GetPool().push_back(std::move(scores_));
+}
+
+SearchServer::RangeScores& SearchServer::ThreadRangeScores::operator*() const {
+    return *scores_;
+}
+
+std::vector<std::unique_ptr<SearchServer::RangeScores>>& SearchServer::ThreadRangeScores::GetPool() {
+    thread_local std::vector<std::unique_ptr<RangeScores>> pool;
+    return pool;
+}
+
+SearchServer::ScoringTerms SearchServer::PrepareScoringTerms(const Query& query) const {
+    ScoringTerms terms;
+    for (const std::string_view word : query.plus_words) {
+        const TermId term = dictionary_.Find(word);
+        if (term != NO_TERM && index_.GetDocumentFreq(term) > 0) {
+            terms.plus_terms.push_back({term, ComputeWordInverseDocumentFreq(term)});
+        }
+    }
+    for (const std::string_view word : query.minus_words) {
+        const TermId term = dictionary_.Find(word);
+        if (term != NO_TERM) {
+            terms.minus_terms.push_back(term);
+        }
+    }
+    return terms;
+}
+
+SearchServer::BatchTerms SearchServer::PrepareBatchTerms(const std::vector<Query>& queries, size_t first_query, size_t last_query) const {
+    std::map<std::string_view, std::vector<size_t>> plus_words;
+    std::map<std::string_view, std::vector<size_t>> minus_words;
+    for (size_t query = first_query; query < last_query; ++query) {
+        for (const std::string_view word : queries[query].plus_words) {
+            plus_words[word].push_back(query - first_query);
+        }
+        for (const std::string_view word : queries[query].minus_words) {
+            minus_words[word].push_back(query - first_query);
+        }
+    }
+
+    BatchTerms terms;
+    for (auto& [word, word_queries] : plus_words) {
+        const TermId term = dictionary_.Find(word);
+        if (term != NO_TERM && index_.GetDocumentFreq(term) > 0) {
+            terms.plus_terms.push_back({term, ComputeWordInverseDocumentFreq(term), std::move(word_queries)});
+        }
+    }
+    for (auto& [word, word_queries] : minus_words) {
+        const TermId term = dictionary_.Find(word);
+        if (term != NO_TERM) {
+            terms.minus_terms.push_back({term, std::move(word_queries)});
+        }
+    }
+    return terms;
+}
+
+size_t SearchServer::GetOrdinalCount() const {
+    return document_ids_.size();
+}
+
+std::vector<DocumentOrdinal> SearchServer::MakeLiveOrdinals() const {
+    std::vector<DocumentOrdinal> new_ordinals(GetOrdinalCount(), NO_ORDINAL);
+    for (const auto [document_id, ordinal] : document_ordinals_) {
+        new_ordinals[ordinal] = 0;
+    }
+    DocumentOrdinal next_ordinal = 0;
+    for (DocumentOrdinal& new_ordinal : new_ordinals) {
+        if (new_ordinal != NO_ORDINAL) {
+            new_ordinal = next_ordinal++;
+        }
+    }
+    return new_ordinals;
+}
+
+DocumentOrdinal SearchServer::GetOrdinal(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        throw std::out_of_range("document_id out of range"s);
+    }
+    return it->second;
+}
+
+bool SearchServer::HasTerm(DocumentOrdinal ordinal, const std::string_view word) const {
+    const TermId term = dictionary_.Find(word);
+    if (term == NO_TERM) {
+        return false;
+    }
+    return document_terms_.HasTerm(ordinal, term);
 }
 
 const std::map<string_view, double> &SearchServer::GetWordFrequencies(int document_id) const {
-    if(documents_words_freqs_.find(document_id) == documents_words_freqs_.end()) {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
         return empty_map;
     }
-    return documents_words_freqs_.at(document_id);
+    const DocumentOrdinal ordinal = it->second;
+
+    std::lock_guard guard(word_frequencies_cache_.mutex);
+    auto [cache_it, inserted] = word_frequencies_cache_.word_freqs.try_emplace(ordinal);
+    if (inserted) {
+        document_terms_.ForEachTerm(ordinal, [&](TermId term, double freq) {
+            cache_it->second.emplace(dictionary_.GetWord(term), freq);
+        });
+    }
+    return cache_it->second;
 }
 
 
@@ -1,27 +1,71 @@
 #pragma once
 
+#include <exception>
 #include <execution>
 #include <vector>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
+#include <unordered_set>
 #include <set>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <limits>
 #include <numeric>
+#include <thread>
 
-#include "concurrent_map.h"
 #include "document.h"
+#include "forward_index.h"
+#include "index_file.h"
+#include "inverse_document_freq_cache.h"
+#include "inverted_index.h"
+#include "log_duration.h"
+#include "query_result_cache.h"
+#include "stop_word_set.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
 
 
+// Размер выдачи по умолчанию, каждый вызов FindTopDocuments может задать свой top_k
 constexpr int MAX_RESULT_DOCUMENT_COUNT = 5;
-const int CONCURRENT_MAP_BUCKETS = 101;
-constexpr double RELEVANCE_EQUALITY_TRESHOLD = 1e-6;
+// Параллельный поиск делит номера документов на диапазоны не короче PARALLEL_SCORING_MIN_RANGE,
+// диапазонов не больше PARALLEL_SCORING_RANGES_PER_THREAD на поток
+constexpr size_t PARALLEL_SCORING_MIN_RANGE = 4096;
+constexpr size_t PARALLEL_SCORING_RANGES_PER_THREAD = 4;
+// Если затронуто меньше 1/SPARSE_SCORING_MAX_DENSITY номеров диапазона, документы собираются
+// по отсортированному списку затронутых номеров, а не просмотром всего диапазона
+constexpr size_t SPARSE_SCORING_MAX_DENSITY = 16;
+// Пакетный поиск обходит постинги слов общих для группы не больше BATCH_QUERY_GROUP_SIZE
+// запросов один раз, номера документов делятся на диапазоны по BATCH_SCORING_RANGE
+constexpr size_t BATCH_QUERY_GROUP_SIZE = 128;
+constexpr size_t BATCH_SCORING_RANGE = 512;
+// Автоматические стоп-слова определяются не раньше, чем в корпусе наберётся столько документов:
+// на маленьком корпусе доля документов со словом мало о нём говорит
+constexpr int AUTO_STOP_WORDS_MIN_DOCUMENT_COUNT = 1000;
+// Номера удалённых документов освобождаются, когда их не меньше ORDINAL_RENUMBER_MIN_REMOVED
+// и не меньше четверти всех номеров: живые документы получают номера подряд в прежнем порядке
+constexpr size_t ORDINAL_RENUMBER_MIN_REMOVED = 4096;
+
+// EXHAUSTIVE оценивает все постинги слов запроса, MAX_SCORE пропускает документы,
+// которые по верхним оценкам релевантности слов не могут попасть в top_k.
+// Результаты обоих режимов совпадают.
+enum class RetrievalMode {
+    EXHAUSTIVE,
+    MAX_SCORE,
+};
 
 class SearchServer {
+    // Шардам нужен разбор запроса и частоты слов, чтобы считать IDF по всему корпусу
+    friend class ShardedSearchServer;
+    // Исполнителю запросов нужна оценка по диапазонам номеров документов
+    friend class QueryExecutor;
+
 public:
 
     template <typename StringContainer>
@@ -30,19 +74,34 @@ public:
           
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Результат совпадает с последовательными вызовами AddDocument: документы до первого
+    // некорректного добавляются, затем выбрасывается то же исключение, что и у AddDocument
+    template <typename ExecutionPolicy>
+    void AddDocuments(const ExecutionPolicy& policy, const std::vector<DocumentInput>& documents);
+    void AddDocuments(const std::vector<DocumentInput>& documents);
+
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT, RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = MAX_RESULT_DOCUMENT_COUNT, RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
     template <typename ExecutionPolicy, typename Predicate>
     std::vector<Document>
-    FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate) const;
+    FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
     std::vector<Document>
-    FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const;
+    FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query) const;
 
+    // i-й результат совпадает с FindTopDocuments(raw_queries[i], status, top_k), но постинги слова,
+    // общего для нескольких запросов группы, обходятся один раз. Все запросы разбираются
+    // до поиска, ошибка разбора любого из них выбрасывается сразу. Кэш результатов не используется.
+    // raw_queries — контейнер из строк или string_view
+    template <typename ExecutionPolicy, typename QueryContainer>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const ExecutionPolicy& policy, const QueryContainer& raw_queries,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
     int GetDocumentCount() const;
 
 // MatchDocument
@@ -50,12 +109,56 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy& policy, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& policy, const std::string_view raw_query, int document_id) const;
 
-    std::set<int>::const_iterator begin() const {
-        return document_ids_.cbegin();
+    // Перебирает id документов по возрастанию
+    class DocumentIdIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        explicit DocumentIdIterator(std::map<int, DocumentOrdinal>::const_iterator it)
+            : it_(it) {
+        }
+
+        reference operator*() const {
+            return it_->first;
+        }
+
+        pointer operator->() const {
+            return &it_->first;
+        }
+
+        DocumentIdIterator& operator++() {
+            ++it_;
+            return *this;
+        }
+
+        DocumentIdIterator operator++(int) {
+            auto old = *this;
+            ++it_;
+            return old;
+        }
+
+        bool operator==(const DocumentIdIterator& other) const {
+            return it_ == other.it_;
+        }
+
+        bool operator!=(const DocumentIdIterator& other) const {
+            return it_ != other.it_;
+        }
+
+    private:
+        std::map<int, DocumentOrdinal>::const_iterator it_;
+    };
+
+    DocumentIdIterator begin() const {
+        return DocumentIdIterator(document_ordinals_.cbegin());
     }
 
-    std::set<int>::const_iterator end() const {
-        return document_ids_.cend();
+    DocumentIdIterator end() const {
+        return DocumentIdIterator(document_ordinals_.cend());
     }
 
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
@@ -64,26 +167,70 @@ public:
     void RemoveDocument(ExecutionPolicy policy, int document_id);
     void RemoveDocument(int document_id);
 
+    // Сохраняет стоп-слова, словарь, живые документы и постинги в бинарный файл.
+    // LoadIndex отображает файл в память и использует постинги из него без копирования,
+    // поэтому запуск не требует повторного разбора документов.
+    void SaveIndex(const std::string& path) const;
+    static SearchServer LoadIndex(const std::string& path);
+
+    // Формат хранения постингов, см. PostingEncoding. Индекс перестраивается сразу
+    void SetPostingEncoding(PostingEncoding encoding);
+    IndexMemoryUsage GetIndexMemoryUsage() const;
+    InverseDocumentFreqCacheStats GetInverseDocumentFreqCacheStats() const;
+
+    // Кэш результатов FindTopDocuments с фильтром по статусу, не больше capacity байт, 0 выключает.
+    // Ключ — разобранный запрос без повторов и стоп-слов, поэтому порядок и повторы слов
+    // не влияют на попадание. Любое изменение индекса делает записи устаревшими
+    void SetQueryResultCacheCapacity(size_t capacity);
+    QueryResultCacheStats GetQueryResultCacheStats() const;
+
+    // Автоматические стоп-слова: плюс-слово, которое встречается больше чем в max_document_share
+    // документов, пропускается при поиске и в MatchDocument, если в корпусе не меньше min_document_count
+    // документов. Минус-слова действуют как обычно и исключают документы с частыми словами.
+    // Доля проверяется при каждом разборе запроса, а постинги таких слов остаются в индексе,
+    // поэтому слово возвращается в поиск, как только его доля падает. IDF остальных слов
+    // не меняется. Настройка не сохраняется в файл индекса. max_document_share >= 1 выключает режим
+    void SetAutoStopWords(double max_document_share, int min_document_count = AUTO_STOP_WORDS_MIN_DOCUMENT_COUNT);
+    // Текущие автоматические стоп-слова и число документов с ними, по убыванию числа документов
+    std::vector<std::pair<std::string_view, size_t>> GetAutoStopWords() const;
+
 
 private:
 
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // Словарь частот строится по требованию, так как внутри документы хранят номера слов.
+    // При копировании сервера кэш не копируется: он ссылается на строки исходного словаря.
+    class WordFrequenciesCache {
+    public:
+        WordFrequenciesCache() = default;
+        WordFrequenciesCache(const WordFrequenciesCache&) {
+        }
+        WordFrequenciesCache& operator=(const WordFrequenciesCache&) = delete;
+
+        std::mutex mutex;
+        std::map<DocumentOrdinal, std::map<std::string_view, double>> word_freqs;
     };
 
     const std::map<std::string_view, double> empty_map;
     const std::vector<std::string_view> empty_vector;
 
-    const std::set<std::string, std::less<>> stop_words_;
-    std::set<std::string, std::less<>> words_;
-    
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
-    std::map<int, std::map<std::string_view, double>> documents_words_freqs_;
+    const StopWordSet stop_words_;
+    TermDictionary dictionary_;
+    InvertedIndex index_;
+
+    // id документа используется только на границе API, внутри — плотный номер
+    std::map<int, DocumentOrdinal> document_ordinals_;
+    std::vector<int> document_ids_;
+    std::vector<int> document_ratings_;
+    std::vector<DocumentStatus> document_statuses_;
+    ForwardIndex document_terms_;
+    mutable WordFrequenciesCache word_frequencies_cache_;
+    InverseDocumentFreqCache inverse_document_freqs_;
+    mutable QueryResultCache query_results_;
+    double auto_stop_word_share_ = 1.0;
+    int auto_stop_word_min_document_count_ = AUTO_STOP_WORDS_MIN_DOCUMENT_COUNT;
 
     bool IsStopWord(const std::string_view word) const;
+    bool IsAutoStopTerm(TermId term) const;
 
     static bool IsValidWord(const std::string_view word);
 
@@ -91,13 +238,36 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    // Сворачивает номера слов документа в отсортированный список частот
+    static std::vector<TermFreq> ComputeTermFreqs(std::vector<TermId> terms);
+
+    // Проверенный пакет: слова документов до первого некорректного и исключение этого документа
+    struct DocumentBatch {
+        std::vector<std::vector<std::string_view>> words;
+        size_t valid_count = 0;
+        std::exception_ptr error;
+    };
+
+    // Проверяет пакет, не меняя сервер
+    template <typename ExecutionPolicy>
+    DocumentBatch PrepareDocuments(const ExecutionPolicy& policy, const std::vector<DocumentInput>& documents) const;
+    // Добавляет первые batch.valid_count документов пакета
+    template <typename ExecutionPolicy>
+    void AddPreparedDocuments(const ExecutionPolicy& policy, const std::vector<DocumentInput>& documents, const DocumentBatch& batch);
+
+    void AppendDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings,
+                        std::vector<TermFreq> term_freqs);
+    // Вызывается после каждого изменения документов или индекса
+    void InvalidateCaches();
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(const std::string_view text) const;
+    // has_control — есть ли в слове управляющие символы, его находит WordTokenizer
+    QueryWord ParseQueryWord(const std::string_view text, bool has_control) const;
 
     struct Query {
         std::vector<std::string_view> plus_words;
@@ -108,28 +278,146 @@ private:
     template <typename ExecutionPolicy>
     Query ParseQuery(const ExecutionPolicy& policy, const std::string_view text, const bool make_unique = true) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // IDF из кэша, при устаревшем значении вычисляется заново
+    double ComputeWordInverseDocumentFreq(TermId term) const;
+    double ComputeTermInverseDocumentFreq(TermId term) const;
+    static double ComputeInverseDocumentFreq(int document_count, size_t document_freq);
+    // Количество документов со словом, 0 для незнакомого слова
+    size_t GetDocumentFreq(const std::string_view word) const;
+
+    DocumentOrdinal GetOrdinal(int document_id) const;
+    bool HasTerm(DocumentOrdinal ordinal, const std::string_view word) const;
 
+    // inverse_document_freqs, если задан, содержит IDF для каждого слова query.plus_words
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate,
+                                           const std::vector<double>* inverse_document_freqs = nullptr) const;
+    // При равной релевантности способы отбора могут вернуть разные документы,
+    // поэтому режим и параллельность входят в ключ
+    static std::string MakeQueryResultKey(const Query& query, DocumentStatus status, size_t top_k,
+                                          RetrievalMode mode, bool is_parallel);
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByQuery(const Query& query, DocumentPredicate document_predicate, size_t top_k, RetrievalMode mode) const;
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByQuery(const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate, size_t top_k) const;
+    // Результат из кэша или вычисленный find(query) с сохранением в кэш
+    template <typename ExecutionPolicy, typename Find>
+    std::vector<Document> FindTopDocumentsCached(const ExecutionPolicy& policy, const std::string_view raw_query,
+                                                 DocumentStatus status, size_t top_k, RetrievalMode mode, Find find) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsMaxScore(const Query& query, DocumentPredicate document_predicate, size_t top_k) const;
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& policy, const Query& query, DocumentPredicate document_predicate) const;
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate) const;
+
+    // Состояние документа при оценке диапазона номеров
+    enum class ScoringState : char {
+        UNMATCHED,
+        MATCHED,
+        EXCLUDED,
+    };
+
+    // Слова запроса, подготовленные для оценки по диапазонам номеров документов
+    struct ScoringTerms {
+        struct PlusTerm {
+            TermId term;
+            double inverse_document_freq;
+        };
+        std::vector<PlusTerm> plus_terms;
+        std::vector<TermId> minus_terms;
+    };
+
+    // Накопители оценки диапазона номеров. У каждого потока свои, они живут между запросами
+    // и после оценки сбрасываются только в затронутых позициях, поэтому цена оценки зависит
+    // от числа постингов слов запроса в диапазоне, а не от его длины
+    struct RangeScores {
+        std::vector<double> relevances;
+        std::vector<ScoringState> states;
+        // Смещения от начала диапазона в порядке первого попадания. Когда затронута
+        // 1/SPARSE_SCORING_MAX_DENSITY диапазона, список перестаёт расти: дальше диапазон
+        // просматривается и сбрасывается целиком
+        std::vector<DocumentOrdinal> touched;
+        size_t range_size = 0;
+
+        bool IsDense() const {
+            return touched.size() * SPARSE_SCORING_MAX_DENSITY >= range_size;
+        }
+
+        void Touch(DocumentOrdinal offset) {
+            if (!IsDense()) {
+                touched.push_back(offset);
+            }
+        }
+
+        void Reset();
+    };
+
+    // Берёт накопители не короче range_size из запаса текущего потока и при разрушении
+    // сбрасывает и возвращает их, в том числе при исключении из предиката. Вложенная оценка
+    // на том же потоке, например параллельный поиск внутри предиката, получает другие накопители
+    class ThreadRangeScores {
+    public:
+        explicit ThreadRangeScores(size_t range_size);
+        ThreadRangeScores(const ThreadRangeScores&) = delete;
+        ThreadRangeScores& operator=(const ThreadRangeScores&) = delete;
+        ~ThreadRangeScores();
+
+        RangeScores& operator*() const;
+
+    private:
+        std::unique_ptr<RangeScores> scores_;
+
+        static std::vector<std::unique_ptr<RangeScores>>& GetPool();
+    };
+
+    ScoringTerms PrepareScoringTerms(const Query& query) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> ScoreOrdinalRange(const ScoringTerms& terms, DocumentPredicate document_predicate,
+                                            DocumentOrdinal first, DocumentOrdinal last) const;
+    size_t GetOrdinalCount() const;
+    // Новые номера живых документов подряд в прежнем порядке, NO_ORDINAL у удалённых
+    std::vector<DocumentOrdinal> MakeLiveOrdinals() const;
+    // Освобождает номера удалённых документов, меняя номера в индексах и кэше частот слов
+    template <typename ExecutionPolicy>
+    void RenumberOrdinals(const ExecutionPolicy& policy);
+
+    // Различные слова группы запросов пакета с номерами запросов группы, в которых они есть.
+    // Плюс-слова идут по возрастанию, как в каждом разобранном запросе, поэтому вклады
+    // в релевантность складываются в том же порядке, что и при поиске по одному запросу
+    struct BatchTerms {
+        struct PlusTerm {
+            TermId term;
+            double inverse_document_freq;
+            std::vector<size_t> queries;
+        };
+        struct MinusTerm {
+            TermId term;
+            std::vector<size_t> queries;
+        };
+        std::vector<PlusTerm> plus_terms;
+        std::vector<MinusTerm> minus_terms;
+    };
+
+    BatchTerms PrepareBatchTerms(const std::vector<Query>& queries, size_t first_query, size_t last_query) const;
+    // Документы диапазона [first, last) для каждого запроса группы по возрастанию номеров,
+    // пустой список, если в диапазоне нет совпадений
+    template <typename DocumentPredicate>
+    std::vector<std::vector<Document>> ScoreBatchOrdinalRange(const BatchTerms& terms, size_t query_count, DocumentPredicate document_predicate,
+                                                              DocumentOrdinal first, DocumentOrdinal last) const;
 };
 
 
 template <typename ExecutionPolicy>
 SearchServer::Query SearchServer::ParseQuery(const ExecutionPolicy& policy, const std::string_view text, const bool make_unique) const {
+    PROFILE_SCOPE("parse");
     Query result;
     bool has_minus = false;
     bool has_plus = false;
-    const auto& words = SplitIntoWords(text);
-    for_each(/*policy,*/ words.begin(), words.end(),
+    ForEachWord(text,
         [this, &has_minus, &has_plus, &result]
-        (std::string_view word) {
-         const auto query_word = ParseQueryWord(word);
+        (std::string_view word, bool has_control) {
+         const auto query_word = ParseQueryWord(word, has_control);
          if (!query_word.is_stop) {
              if (query_word.is_minus) {
                  has_minus = true;
@@ -171,108 +459,332 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     }
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(std::execution::seq, raw_query);
+template <typename ExecutionPolicy>
+void SearchServer::AddDocuments(const ExecutionPolicy& policy, const std::vector<DocumentInput>& documents) {
+    DocumentBatch batch = PrepareDocuments(policy, documents);
+    AddPreparedDocuments(policy, documents, batch);
+    if (batch.error) {
+        std::rethrow_exception(batch.error);
+    }
+}
 
-    auto matched_documents = FindAllDocuments(query, document_predicate);
+template <typename ExecutionPolicy>
+SearchServer::DocumentBatch SearchServer::PrepareDocuments(const ExecutionPolicy& policy, const std::vector<DocumentInput>& documents) const {
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
 
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EQUALITY_TRESHOLD) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+    DocumentBatch batch;
+    batch.words.resize(documents.size());
+    std::vector<std::exception_ptr> word_errors(documents.size());
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        try {
+            batch.words[i] = SplitIntoWordsNoStop(documents[i].text);
+        } catch (...) {
+            word_errors[i] = std::current_exception();
         }
     });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+
+    std::unordered_set<int> batch_ids;
+    for (; batch.valid_count < documents.size(); ++batch.valid_count) {
+        const int document_id = documents[batch.valid_count].id;
+        if ((document_id < 0) ||
+            (document_ordinals_.count(document_id) > 0) ||
+            !batch_ids.insert(document_id).second) {
+            batch.error = std::make_exception_ptr(std::invalid_argument("Invalid document_id"));
+            break;
+        }
+        if (word_errors[batch.valid_count]) {
+            batch.error = word_errors[batch.valid_count];
+            break;
+        }
     }
-    return matched_documents;
+    return batch;
 }
 
-template <typename ExecutionPolicy, typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments( const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate) const {
-    const Query query = ParseQuery(policy, raw_query);
-    std::vector<Document>
-    matched_documents = FindAllDocuments(policy, query, document_predicate);
- 
-    std::sort(policy, matched_documents.begin(),
-              matched_documents.end(),
-              [](const Document& lhs, const Document& rhs) {
-                  if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EQUALITY_TRESHOLD) {
-                      return lhs.rating > rhs.rating;
-                  } else {
-                      return lhs.relevance > rhs.relevance;
-                  }
-              });
+template <typename ExecutionPolicy>
+void SearchServer::AddPreparedDocuments(const ExecutionPolicy& policy, const std::vector<DocumentInput>& documents, const DocumentBatch& batch) {
+    const size_t valid_count = batch.valid_count;
+    const auto& words = batch.words;
+    std::vector<size_t> indexes(valid_count);
+    std::iota(indexes.begin(), indexes.end(), 0);
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<std::vector<TermId>> terms(valid_count);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        terms[i].reserve(words[i].size());
+        for (const std::string_view word : words[i]) {
+            terms[i].push_back(dictionary_.Find(word));
+        }
+    });
+    // Новые слова получают номера в порядке первого появления, как при AddDocument
+    for (size_t i = 0; i < valid_count; ++i) {
+        for (size_t j = 0; j < terms[i].size(); ++j) {
+            if (terms[i][j] == NO_TERM) {
+                terms[i][j] = dictionary_.Intern(words[i][j]);
+            }
+        }
     }
 
-    return matched_documents;
+    std::vector<std::vector<TermFreq>> term_freqs(valid_count);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        term_freqs[i] = ComputeTermFreqs(std::move(terms[i]));
+    });
+
+    index_.AddDocuments(policy, static_cast<DocumentOrdinal>(document_ids_.size()), term_freqs);
+    for (size_t i = 0; i < valid_count; ++i) {
+        AppendDocument(documents[i].id, documents[i].status, documents[i].ratings, std::move(term_freqs[i]));
+    }
+    // После пакета меняются IDF почти всех слов запросов, таблицу выгоднее пересчитать сразу
+    if (valid_count > 0) {
+        inverse_document_freqs_.Refresh(policy, [this](TermId term) {
+            return ComputeTermInverseDocumentFreq(term);
+        });
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k, RetrievalMode mode) const {
+    PROFILE_SCOPE("FindTopDocuments");
+    return FindTopDocumentsByQuery(ParseQuery(std::execution::seq, raw_query), document_predicate, top_k, mode);
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments( const ExecutionPolicy& policy, const std::string_view raw_query, Predicate document_predicate, size_t top_k) const {
+    PROFILE_SCOPE("FindTopDocuments");
+    return FindTopDocumentsByQuery(policy, ParseQuery(policy, raw_query), document_predicate, top_k);
 }
 
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments( const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
+std::vector<Document> SearchServer::FindTopDocuments( const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+    PROFILE_SCOPE("FindTopDocuments");
+    return FindTopDocumentsCached(policy, raw_query, status, top_k, RetrievalMode::EXHAUSTIVE, [&](const Query& query) {
+        return FindTopDocumentsByQuery(policy, query, [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+        }, top_k);
     });
 }
 
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByQuery(const Query& query, DocumentPredicate document_predicate, size_t top_k, RetrievalMode mode) const {
+    if (mode == RetrievalMode::MAX_SCORE) {
+        return FindTopDocumentsMaxScore(query, document_predicate, top_k);
+    }
+
+    auto matched_documents = FindAllDocuments(query, document_predicate);
+
+    PROFILE_SCOPE("rank");
+    SelectTopDocuments(matched_documents, top_k);
+    return matched_documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByQuery(const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate, size_t top_k) const {
+    std::vector<Document>
+    matched_documents = FindAllDocuments(policy, query, document_predicate);
+
+    PROFILE_SCOPE("rank");
+    SelectTopDocuments(policy, matched_documents, top_k);
+
+    return matched_documents;
+}
+
+template <typename ExecutionPolicy, typename Find>
+std::vector<Document> SearchServer::FindTopDocumentsCached(const ExecutionPolicy& policy, const std::string_view raw_query,
+                                                           DocumentStatus status, size_t top_k, RetrievalMode mode, Find find) const {
+    const Query query = ParseQuery(policy, raw_query);
+    if (!query_results_.IsEnabled()) {
+        return find(query);
+    }
+    constexpr bool is_parallel = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>;
+    std::string key = MakeQueryResultKey(query, status, top_k, mode, is_parallel);
+    if (auto documents = query_results_.Find(key)) {
+        return std::move(*documents);
+    }
+    auto documents = find(query);
+    query_results_.Insert(std::move(key), documents);
+    return documents;
+}
+
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments( const ExecutionPolicy& policy, const std::string_view raw_query) const {
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate,
+                                                     const std::vector<double>* inverse_document_freqs) const {
+    std::map<DocumentOrdinal, double> document_to_relevance;
 
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+    {
+        PROFILE_SCOPE("score");
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            const TermId term = dictionary_.Find(query.plus_words[i]);
+            if (term == NO_TERM) {
+                continue;
+            }
 
-        const double inverse_document_freq =
-                     ComputeWordInverseDocumentFreq(word);
+            const double inverse_document_freq = inverse_document_freqs
+                         ? (*inverse_document_freqs)[i]
+                         : ComputeWordInverseDocumentFreq(term);
 
-        for (const auto [document_id, term_freq] :
-             word_to_document_freqs_.at(word)) {
-            const auto& document_data =
-                documents_.at(document_id);
-            if (document_predicate(document_id,
-                document_data.status,
-                document_data.rating)) {
-                document_to_relevance[document_id] +=
-                    term_freq * inverse_document_freq;
-            }
+            index_.ForEachPosting(term, [&](DocumentOrdinal ordinal, double term_freq) {
+                if (document_predicate(document_ids_[ordinal],
+                    document_statuses_[ordinal],
+                    document_ratings_[ordinal])) {
+                    document_to_relevance[ordinal] +=
+                        term_freq * inverse_document_freq;
+                }
+            });
         }
     }
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+    {
+        PROFILE_SCOPE("exclude");
+        for (const std::string_view word : query.minus_words) {
+            const TermId term = dictionary_.Find(word);
+            if (term == NO_TERM) {
+                continue;
+            }
 
-        for (const auto [document_id, _] :
-            word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+            index_.ForEachPosting(term, [&document_to_relevance](DocumentOrdinal ordinal, double) {
+                document_to_relevance.erase(ordinal);
+            });
         }
     }
 
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] :
+    for (const auto [ordinal, relevance] :
          document_to_relevance) {
         matched_documents.push_back(
-            { document_id, relevance,
-              documents_.at(document_id).rating });
+            { document_ids_[ordinal], relevance,
+              document_ratings_[ordinal] });
     }
 
     return matched_documents;
 }
 
+// FindTopDocumentsMaxScore
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsMaxScore(const Query& query, DocumentPredicate document_predicate, size_t top_k) const {
+    // Оценка, исключение и отбор здесь идут одним проходом
+    PROFILE_SCOPE("score");
+    struct TermCursor {
+        InvertedIndex::PostingCursor postings;
+        double inverse_document_freq;
+        double upper_bound;
+        // Позиция слова в запросе: вклады слов суммируются в том же порядке,
+        // что и в FindAllDocuments, чтобы релевантность совпадала до бита
+        size_t position;
+    };
+
+    std::vector<TermCursor> terms;
+    for (size_t position = 0; position < query.plus_words.size(); ++position) {
+        const TermId term = dictionary_.Find(query.plus_words[position]);
+        if (term == NO_TERM || index_.GetDocumentFreq(term) == 0) {
+            continue;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term);
+        terms.push_back({index_.GetPostings(term), inverse_document_freq,
+                         index_.GetMaxTermFreq(term) * inverse_document_freq, position});
+    }
+
+    std::vector<InvertedIndex::PostingCursor> minus_postings;
+    for (const std::string_view word : query.minus_words) {
+        const TermId term = dictionary_.Find(word);
+        if (term != NO_TERM) {
+            minus_postings.push_back(index_.GetPostings(term));
+        }
+    }
+
+    // Слова упорядочены по возрастанию верхней оценки, bound_prefix[i] — сумма оценок первых i слов.
+    // Слова [0, first_essential) вместе не могут дать документу место в top_k,
+    // поэтому кандидаты берутся только из постингов остальных слов.
+    std::sort(terms.begin(), terms.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.upper_bound < rhs.upper_bound;
+    });
+    std::vector<double> bound_prefix(terms.size() + 1, 0.0);
+    for (size_t i = 0; i < terms.size(); ++i) {
+        bound_prefix[i + 1] = bound_prefix[i] + terms[i].upper_bound;
+    }
+
+    // Запас в два порога равенства: документ с оценкой не выше threshold не обходит худший в куче
+    // даже с учётом сравнения по рейтингу и погрешности суммирования
+    const double margin = 2 * RELEVANCE_EQUALITY_TRESHOLD;
+    std::vector<Document> top_documents;
+    std::vector<double> contributions(query.plus_words.size(), 0.0);
+    size_t first_essential = 0;
+
+    const auto is_hopeless = [&](double bound) {
+        return top_documents.size() == top_k
+               && bound <= top_documents.front().relevance - margin;
+    };
+
+    while (top_k > 0) {
+        DocumentOrdinal candidate = std::numeric_limits<DocumentOrdinal>::max();
+        bool has_candidate = false;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            if (!terms[i].postings.IsEnd() && terms[i].postings.GetOrdinal() <= candidate) {
+                candidate = terms[i].postings.GetOrdinal();
+                has_candidate = true;
+            }
+        }
+        if (!has_candidate) {
+            break;
+        }
+
+        bool rejected = !document_predicate(document_ids_[candidate],
+                                            document_statuses_[candidate],
+                                            document_ratings_[candidate]);
+        for (auto& postings : minus_postings) {
+            if (rejected) {
+                break;
+            }
+            postings.SkipTo(candidate);
+            rejected = !postings.IsEnd() && postings.GetOrdinal() == candidate;
+        }
+
+        double partial_score = 0.0;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            auto& term = terms[i];
+            if (!term.postings.IsEnd() && term.postings.GetOrdinal() == candidate) {
+                contributions[term.position] = term.postings.GetTermFreq() * term.inverse_document_freq;
+                partial_score += contributions[term.position];
+                term.postings.Next();
+            }
+        }
+
+        for (size_t i = first_essential; !rejected && i-- > 0;) {
+            if (is_hopeless(partial_score + bound_prefix[i + 1])) {
+                rejected = true;
+                break;
+            }
+            auto& term = terms[i];
+            term.postings.SkipTo(candidate);
+            if (!term.postings.IsEnd() && term.postings.GetOrdinal() == candidate) {
+                contributions[term.position] = term.postings.GetTermFreq() * term.inverse_document_freq;
+                partial_score += contributions[term.position];
+            }
+        }
+
+        if (!rejected) {
+            double relevance = 0.0;
+            for (const double contribution : contributions) {
+                relevance += contribution;
+            }
+            PushTopDocument(top_documents,
+                            {document_ids_[candidate], relevance, document_ratings_[candidate]},
+                            top_k);
+            while (first_essential < terms.size() && is_hopeless(bound_prefix[first_essential + 1])) {
+                ++first_essential;
+            }
+        }
+        std::fill(contributions.begin(), contributions.end(), 0.0);
+    }
+
+    std::sort(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    return top_documents;
+}
+
 // FindAllDocuments sequenced_policy
 template <typename DocumentPredicate>
 std::vector<Document>
@@ -281,75 +793,300 @@ SearchServer::FindAllDocuments( const std::execution::sequenced_policy& policy,
 }
 
 // FindAllDocuments parallel_policy
+// Диапазоны номеров документов оцениваются независимо (ScoreOrdinalRange),
+// поэтому блокировок нет, а результаты совпадают с последовательной версией до бита.
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments( const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> relevances(CONCURRENT_MAP_BUCKETS);
-
-    for_each (policy,
-              query.plus_words.begin(),
-              query.plus_words.end(),
-              [this, &relevances, &document_predicate]
-              (std::string_view word) {
-                  if (word_to_document_freqs_.count(word) == 0) {
-                      return;
-                  }
-                  const double
-                  idf = ComputeWordInverseDocumentFreq(word);
-
-                  for (const auto& [id, freq]
-                       : word_to_document_freqs_.at(word)) {
-                      const DocumentData doc = documents_.at(id);
-                      if (document_predicate(id, doc.status,
-                                             doc.rating)) {
-                          relevances[id].ref_to_value +=
-                              freq * idf;
-                      }
-                  }
-              });
-
-    for_each (policy,
-              query.minus_words.begin(),
-              query.minus_words.end(),
-              [this, &relevances]
-              (std::string_view word) {
-                  if (word_to_document_freqs_.count(word) == 0) {
-                      return;
-                  }
-
-                  for (const auto& [id, _]
-                       : word_to_document_freqs_.at(word)) {
-                      relevances.Erase(id);
-                  }
-              });
+    const ScoringTerms terms = PrepareScoringTerms(query);
+    if (terms.plus_terms.empty()) {
+        return {};
+    }
 
+    const size_t ordinal_count = GetOrdinalCount();
+    const size_t max_range_count = std::max<size_t>(1, std::thread::hardware_concurrency()) * PARALLEL_SCORING_RANGES_PER_THREAD;
+    const size_t range_count = std::clamp<size_t>(ordinal_count / PARALLEL_SCORING_MIN_RANGE, 1, max_range_count);
+    const size_t range_size = (ordinal_count + range_count - 1) / range_count;
+
+    std::vector<size_t> ranges(range_count);
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::vector<std::vector<Document>> range_documents(range_count);
+    std::for_each(policy, ranges.begin(), ranges.end(), [&](size_t range) {
+        const DocumentOrdinal first = static_cast<DocumentOrdinal>(range * range_size);
+        const DocumentOrdinal last = static_cast<DocumentOrdinal>(std::min(ordinal_count, (range + 1) * range_size));
+        range_documents[range] = ScoreOrdinalRange(terms, document_predicate, first, last);
+    });
+
+    // Диапазоны идут по возрастанию номеров, порядок документов тот же, что в последовательной версии
     std::vector<Document> matched_documents;
-    for (const auto [id, relevance] :
-         relevances.BuildOrdinaryMap()) {
-        matched_documents.push_back(
-            { id, relevance,
-              documents_.at(id).rating });
+    for (auto& documents : range_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
     }
-
     return matched_documents;
 }
 
+// Обходит постинги всех слов запроса в границах [first, last) и копит релевантность
+// в плотных накопителях потока. Вклады слов суммируются в порядке запроса
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::ScoreOrdinalRange(const ScoringTerms& terms, DocumentPredicate document_predicate,
+                                                      DocumentOrdinal first, DocumentOrdinal last) const {
+    if (first >= last) {
+        return {};
+    }
+
+    const ThreadRangeScores thread_scores(last - first);
+    RangeScores& scores = *thread_scores;
+    auto& relevances = scores.relevances;
+    auto& states = scores.states;
+    auto& touched = scores.touched;
+
+    {
+        PROFILE_SCOPE("score");
+        for (const auto [term, inverse_document_freq] : terms.plus_terms) {
+            auto postings = index_.GetPostings(term);
+            postings.SkipTo(first);
+            for (; !postings.IsEnd() && postings.GetOrdinal() < last; postings.Next()) {
+                const DocumentOrdinal ordinal = postings.GetOrdinal();
+                if (document_predicate(document_ids_[ordinal],
+                                       document_statuses_[ordinal],
+                                       document_ratings_[ordinal])) {
+                    const DocumentOrdinal offset = ordinal - first;
+                    if (states[offset] == ScoringState::UNMATCHED) {
+                        states[offset] = ScoringState::MATCHED;
+                        scores.Touch(offset);
+                    }
+                    relevances[offset] += postings.GetTermFreq() * inverse_document_freq;
+                }
+            }
+        }
+    }
+
+    {
+        PROFILE_SCOPE("exclude");
+        if (!touched.empty()) {
+            for (const TermId term : terms.minus_terms) {
+                auto postings = index_.GetPostings(term);
+                postings.SkipTo(first);
+                for (; !postings.IsEnd() && postings.GetOrdinal() < last; postings.Next()) {
+                    const DocumentOrdinal offset = postings.GetOrdinal() - first;
+                    if (states[offset] == ScoringState::MATCHED) {
+                        states[offset] = ScoringState::EXCLUDED;
+                    }
+                }
+            }
+        }
+    }
+
+    // Документы нужны по возрастанию номеров: немногие затронутые позиции дешевле отсортировать,
+    // при плотном попадании дешевле просмотреть диапазон подряд
+    std::vector<Document> documents;
+    const auto collect = [&](DocumentOrdinal offset) {
+        if (states[offset] == ScoringState::MATCHED) {
+            const DocumentOrdinal ordinal = first + offset;
+            documents.push_back({document_ids_[ordinal], relevances[offset], document_ratings_[ordinal]});
+        }
+    };
+    if (!scores.IsDense()) {
+        std::sort(touched.begin(), touched.end());
+        for (const DocumentOrdinal offset : touched) {
+            collect(offset);
+        }
+    } else {
+        for (DocumentOrdinal offset = 0; offset < last - first; ++offset) {
+            collect(offset);
+        }
+    }
+    return documents;
+}
+
+// FindTopDocumentsBatch
+// Группа запросов оценивается по диапазонам номеров документов так же, как один запрос
+// в параллельном поиске, затем у каждого запроса отбираются лучшие документы
+template <typename ExecutionPolicy, typename QueryContainer>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const ExecutionPolicy& policy, const QueryContainer& raw_queries,
+                                                                       DocumentStatus status, size_t top_k) const {
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const auto& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(std::execution::seq, std::string_view(raw_query)));
+    }
+
+    const auto document_predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    };
+    const size_t ordinal_count = GetOrdinalCount();
+    std::vector<size_t> ranges((ordinal_count + BATCH_SCORING_RANGE - 1) / BATCH_SCORING_RANGE);
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::vector<std::vector<std::vector<Document>>> range_documents(ranges.size());
+
+    std::vector<std::vector<Document>> results(queries.size());
+    for (size_t first_query = 0; first_query < queries.size(); first_query += BATCH_QUERY_GROUP_SIZE) {
+        const size_t last_query = std::min(queries.size(), first_query + BATCH_QUERY_GROUP_SIZE);
+        const BatchTerms terms = PrepareBatchTerms(queries, first_query, last_query);
+        if (terms.plus_terms.empty()) {
+            continue;
+        }
+
+        std::for_each(policy, ranges.begin(), ranges.end(), [&](size_t range) {
+            const DocumentOrdinal first = static_cast<DocumentOrdinal>(range * BATCH_SCORING_RANGE);
+            const DocumentOrdinal last = static_cast<DocumentOrdinal>(std::min(ordinal_count, (range + 1) * BATCH_SCORING_RANGE));
+            range_documents[range] = ScoreBatchOrdinalRange(terms, last_query - first_query, document_predicate, first, last);
+        });
+
+        std::vector<size_t> group(last_query - first_query);
+        std::iota(group.begin(), group.end(), 0);
+        std::for_each(policy, group.begin(), group.end(), [&](size_t query) {
+            // Диапазоны идут по возрастанию номеров, как документы в последовательном поиске
+            std::vector<Document>& documents = results[first_query + query];
+            for (const auto& range : range_documents) {
+                // Диапазон без совпадений возвращает пустой список
+                if (!range.empty()) {
+                    documents.insert(documents.end(), range[query].begin(), range[query].end());
+                }
+            }
+            SelectTopDocuments(documents, top_k);
+        });
+    }
+    return results;
+}
+
+// Каждый постинг обходится один раз, его вклад прибавляется ко всем запросам группы со словом.
+// Счётчики диапазона лежат по документам, запросы одного документа — рядом. Накопители берутся
+// из запаса потока, как в ScoreOrdinalRange, и сбрасываются только в затронутых ячейках
+template <typename DocumentPredicate>
+std::vector<std::vector<Document>> SearchServer::ScoreBatchOrdinalRange(const BatchTerms& terms, size_t query_count, DocumentPredicate document_predicate,
+                                                                        DocumentOrdinal first, DocumentOrdinal last) const {
+    const size_t cell_count = (last - first) * query_count;
+    const ThreadRangeScores thread_scores(cell_count);
+    RangeScores& scores = *thread_scores;
+    auto& relevances = scores.relevances;
+    auto& states = scores.states;
+    auto& touched = scores.touched;
+
+    for (const auto& plus_term : terms.plus_terms) {
+        auto postings = index_.GetPostings(plus_term.term);
+        postings.SkipTo(first);
+        for (; !postings.IsEnd() && postings.GetOrdinal() < last; postings.Next()) {
+            const DocumentOrdinal ordinal = postings.GetOrdinal();
+            if (!document_predicate(document_ids_[ordinal],
+                                    document_statuses_[ordinal],
+                                    document_ratings_[ordinal])) {
+                continue;
+            }
+            const double relevance = postings.GetTermFreq() * plus_term.inverse_document_freq;
+            const size_t offset = (ordinal - first) * query_count;
+            for (const size_t query : plus_term.queries) {
+                const size_t cell = offset + query;
+                if (states[cell] == ScoringState::UNMATCHED) {
+                    states[cell] = ScoringState::MATCHED;
+                    scores.Touch(static_cast<DocumentOrdinal>(cell));
+                }
+                relevances[cell] += relevance;
+            }
+        }
+    }
+    if (touched.empty()) {
+        return {};
+    }
+
+    for (const auto& minus_term : terms.minus_terms) {
+        auto postings = index_.GetPostings(minus_term.term);
+        postings.SkipTo(first);
+        for (; !postings.IsEnd() && postings.GetOrdinal() < last; postings.Next()) {
+            const size_t offset = (postings.GetOrdinal() - first) * query_count;
+            for (const size_t query : minus_term.queries) {
+                if (states[offset + query] == ScoringState::MATCHED) {
+                    states[offset + query] = ScoringState::EXCLUDED;
+                }
+            }
+        }
+    }
+
+    // Ячейки по возрастанию идут по возрастанию номеров документов
+    std::vector<std::vector<Document>> documents(query_count);
+    const auto collect = [&](DocumentOrdinal ordinal, size_t query, size_t cell) {
+        if (states[cell] == ScoringState::MATCHED) {
+            documents[query].push_back({document_ids_[ordinal], relevances[cell], document_ratings_[ordinal]});
+        }
+    };
+    if (!scores.IsDense()) {
+        std::sort(touched.begin(), touched.end());
+        for (const DocumentOrdinal cell : touched) {
+            collect(first + static_cast<DocumentOrdinal>(cell / query_count), cell % query_count, cell);
+        }
+    } else {
+        for (DocumentOrdinal ordinal = first; ordinal < last; ++ordinal) {
+            const size_t offset = (ordinal - first) * query_count;
+            for (size_t query = 0; query < query_count; ++query) {
+                collect(ordinal, query, offset + query);
+            }
+        }
+    }
+    return documents;
+}
+
 //RemoveDocument
 template<typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy policy, int document_id) {
-    documents_.erase(document_id);
-
-    std::vector<std::string_view> words;
-    for (auto [word, _] : GetWordFrequencies(document_id)) {
-        words.push_back(word);
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        return;
     }
+    const DocumentOrdinal ordinal = it->second;
 
-    std::for_each(policy, words.begin(), words.end(), [&](std::string_view word) {
-        if (word_to_document_freqs_.count(word) > 0) {
-            word_to_document_freqs_.at(word).erase(document_id);
-        }
+    std::vector<TermId> terms;
+    document_terms_.ForEachTerm(ordinal, [&terms](TermId term, double) {
+        terms.push_back(term);
     });
 
-    documents_words_freqs_.erase(document_id);
-    document_ids_.erase(document_id);
+    index_.RemovePostings(policy, ordinal, terms);
+
+    document_ordinals_.erase(it);
+    InvalidateCaches();
+    document_terms_.ClearDocument(ordinal);
+    {
+        std::lock_guard guard(word_frequencies_cache_.mutex);
+        word_frequencies_cache_.word_freqs.erase(ordinal);
+    }
+
+    const size_t removed_count = GetOrdinalCount() - document_ordinals_.size();
+    if (removed_count >= ORDINAL_RENUMBER_MIN_REMOVED && removed_count * 4 >= GetOrdinalCount()) {
+        RenumberOrdinals(policy);
+    }
 }
 
+template <typename ExecutionPolicy>
+void SearchServer::RenumberOrdinals(const ExecutionPolicy& policy) {
+    const std::vector<DocumentOrdinal> new_ordinals = MakeLiveOrdinals();
+    const size_t ordinal_count = GetOrdinalCount();
+    for (DocumentOrdinal ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        const DocumentOrdinal new_ordinal = new_ordinals[ordinal];
+        if (new_ordinal != NO_ORDINAL) {
+            document_ids_[new_ordinal] = document_ids_[ordinal];
+            document_ratings_[new_ordinal] = document_ratings_[ordinal];
+            document_statuses_[new_ordinal] = document_statuses_[ordinal];
+        }
+    }
+    document_ids_.resize(document_ordinals_.size());
+    document_ratings_.resize(document_ordinals_.size());
+    document_statuses_.resize(document_ordinals_.size());
+    document_ids_.shrink_to_fit();
+    document_ratings_.shrink_to_fit();
+    document_statuses_.shrink_to_fit();
+    for (auto& [document_id, ordinal] : document_ordinals_) {
+        ordinal = new_ordinals[ordinal];
+    }
+
+    document_terms_.Renumber(new_ordinals);
+    index_.Renumber(policy, new_ordinals);
+
+    // Узлы кэша переносятся под новые номера, поэтому выданные ссылки остаются действительными
+    std::lock_guard guard(word_frequencies_cache_.mutex);
+    auto& word_freqs = word_frequencies_cache_.word_freqs;
+    std::map<DocumentOrdinal, std::map<std::string_view, double>> renumbered;
+    while (!word_freqs.empty()) {
+        auto node = word_freqs.extract(word_freqs.begin());
+        node.key() = new_ordinals[node.key()];
+        renumbered.insert(renumbered.end(), std::move(node));
+    }
+    word_freqs.swap(renumbered);
+}
@@ -0,0 +1,102 @@
+#include <exception>
+#include <numeric>
+
+#include "sharded_search_server.h"
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(const std::string_view stop_words_text, size_t shard_count)
+    : shards_(std::max<size_t>(shard_count, 1), SearchServer(stop_words_text)) {
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::AddDocuments(const std::vector<DocumentInput>& documents) {
+    std::vector<std::vector<DocumentInput>> shard_documents(shards_.size());
+    std::vector<std::vector<size_t>> batch_positions(shards_.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const size_t shard = GetShardIndex(documents[i].id);
+        shard_documents[shard].push_back(documents[i]);
+        batch_positions[shard].push_back(i);
+    }
+
+    // Шарды проверяют свои части до того, как что-либо добавить: повторы id всегда попадают
+    // в один шард, поэтому первый некорректный документ пакета — первый из найденных шардами
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::vector<SearchServer::DocumentBatch> batches(shards_.size());
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard) {
+        batches[shard] = shards_[shard].PrepareDocuments(std::execution::seq, shard_documents[shard]);
+    });
+    size_t error_position = documents.size();
+    std::exception_ptr error;
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        const SearchServer::DocumentBatch& batch = batches[shard];
+        if (batch.error && batch_positions[shard][batch.valid_count] < error_position) {
+            error_position = batch_positions[shard][batch.valid_count];
+            error = batch.error;
+        }
+    }
+
+    // Каждый шард добавляет только документы, стоящие в пакете до первого некорректного
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard) {
+        const auto& positions = batch_positions[shard];
+        batches[shard].valid_count = std::lower_bound(positions.begin(), positions.begin() + batches[shard].valid_count,
+                                                      error_position) - positions.begin();
+        shards_[shard].AddPreparedDocuments(std::execution::seq, shard_documents[shard], batches[shard]);
+    });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    }, top_k);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Отрицательный id отправляется в нулевой шард, который отклонит его сам
+    return document_id < 0 ? 0 : static_cast<size_t>(document_id) % shards_.size();
+}
+
+std::vector<double> ShardedSearchServer::ComputeInverseDocumentFreqs(const SearchServer::Query& query) const {
+    const int document_count = GetDocumentCount();
+    std::vector<double> inverse_document_freqs;
+    inverse_document_freqs.reserve(query.plus_words.size());
+    for (const std::string_view word : query.plus_words) {
+        size_t document_freq = 0;
+        for (const SearchServer& shard : shards_) {
+            document_freq += shard.GetDocumentFreq(word);
+        }
+        inverse_document_freqs.push_back(SearchServer::ComputeInverseDocumentFreq(document_count, document_freq));
+    }
+    return inverse_document_freqs;
+}
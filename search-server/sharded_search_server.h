@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+// Документы распределяются по шардам по id (document_id % shard_count).
+// Запрос разбирается один раз, IDF считается по суммарным частотам всех шардов,
+// шарды ищут параллельно, а их top_k объединяются. Выдача совпадает с выдачей
+// одного SearchServer с теми же документами.
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+    ShardedSearchServer(const std::string_view stop_words_text, size_t shard_count);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Пакет делится между шардами, шарды добавляют свои части параллельно.
+    // Как и SearchServer::AddDocuments, при ошибке добавляются документы пакета
+    // до первого некорректного, затем выбрасывается его исключение.
+    void AddDocuments(const std::vector<DocumentInput>& documents);
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+
+private:
+    std::vector<SearchServer> shards_;
+
+    size_t GetShardIndex(int document_id) const;
+    std::vector<double> ComputeInverseDocumentFreqs(const SearchServer::Query& query) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count)
+    : shards_(std::max<size_t>(shard_count, 1), SearchServer(stop_words)) {
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+    const auto query = shards_.front().ParseQuery(std::execution::seq, raw_query);
+    const auto inverse_document_freqs = ComputeInverseDocumentFreqs(query);
+
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::transform(std::execution::par,
+                   shards_.begin(), shards_.end(), shard_documents.begin(),
+                   [&](const SearchServer& shard) {
+                       auto documents = shard.FindAllDocuments(query, document_predicate, &inverse_document_freqs);
+                       SelectTopDocuments(documents, top_k);
+                       return documents;
+                   });
+
+    std::vector<Document> matched_documents;
+    for (const auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    SelectTopDocuments(matched_documents, top_k);
+    return matched_documents;
+}
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include "snapshot_search_server.h"
+
+using namespace std;
+
+SnapshotSearchServer::Snapshot::Snapshot(Version* version)
+    : version_(version) {
+}
+
+SnapshotSearchServer::Snapshot::Snapshot(Snapshot&& other) noexcept
+    : version_(std::exchange(other.version_, nullptr)) {
+}
+
+SnapshotSearchServer::Snapshot& SnapshotSearchServer::Snapshot::operator=(Snapshot&& other) noexcept {
+    if (this != &other) {
+        if (version_) {
+            version_->readers.fetch_sub(1, std::memory_order_release);
+        }
+        version_ = std::exchange(other.version_, nullptr);
+    }
+    return *this;
+}
+
+SnapshotSearchServer::Snapshot::~Snapshot() {
+    if (version_) {
+        version_->readers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+const SearchServer& SnapshotSearchServer::Snapshot::operator*() const {
+    return version_->server;
+}
+
+const SearchServer* SnapshotSearchServer::Snapshot::operator->() const {
+    return &version_->server;
+}
+
+uint64_t SnapshotSearchServer::Snapshot::GetVersion() const {
+    return version_->number;
+}
+
+SnapshotSearchServer::SnapshotSearchServer(const std::string_view stop_words_text)
+    : current_(new Version(SearchServer(stop_words_text))) {
+}
+
+SnapshotSearchServer::~SnapshotSearchServer() {
+    delete current_.load();
+}
+
+SnapshotSearchServer::Snapshot SnapshotSearchServer::GetSnapshot() const {
+    auto& acquiring = acquiring_[epoch_.load() & 1].count;
+    acquiring.fetch_add(1);
+    Version* version = current_.load();
+    version->readers.fetch_add(1);
+    acquiring.fetch_sub(1);
+    return Snapshot(version);
+}
+
+void SnapshotSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Publish([document_id, text = std::string(document), status, ratings](SearchServer& server) {
+        server.AddDocument(document_id, text, status, ratings);
+    });
+}
+
+void SnapshotSearchServer::AddDocuments(const std::vector<DocumentInput>& documents) {
+    auto texts = std::make_shared<std::vector<std::string>>();
+    auto batch = std::make_shared<std::vector<DocumentInput>>(documents);
+    texts->reserve(documents.size());
+    for (auto& document : *batch) {
+        document.text = texts->emplace_back(document.text);
+    }
+    Publish([texts, batch](SearchServer& server) {
+        server.AddDocuments(std::execution::par, *batch);
+    });
+}
+
+void SnapshotSearchServer::RemoveDocument(int document_id) {
+    Publish([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void SnapshotSearchServer::ApplyUpdate(Update update) {
+    Publish(std::move(update));
+}
+
+int SnapshotSearchServer::GetDocumentCount() const {
+    return GetSnapshot()->GetDocumentCount();
+}
+
+void SnapshotSearchServer::Publish(Update update) {
+    std::lock_guard guard(write_mutex_);
+
+    auto next = MakeWritableVersion();
+    // Изменение, выбросившее исключение, публикуется в том виде, в каком оно успело
+    // примениться: так же ведёт себя SearchServer при прямом вызове
+    std::exception_ptr error;
+    try {
+        update(next->server);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    Version* old = current_.load();
+    next->number = old->number + 1;
+    current_.store(next.release());
+    WaitForAcquiringReaders();
+
+    spare_.emplace_back(old);
+    log_.push_back(std::move(update));
+    ReclaimSpare();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool SnapshotSearchServer::CanCatchUp(const Version& version) const {
+    return current_.load()->number - version.number <= SNAPSHOT_MAX_CATCH_UP;
+}
+
+std::unique_ptr<SnapshotSearchServer::Version> SnapshotSearchServer::MakeWritableVersion() {
+    auto freshest = spare_.end();
+    for (auto it = spare_.begin(); it != spare_.end(); ++it) {
+        if ((*it)->readers.load(std::memory_order_acquire) == 0 && CanCatchUp(**it)
+            && (freshest == spare_.end() || (*it)->number > (*freshest)->number)) {
+            freshest = it;
+        }
+    }
+    if (freshest == spare_.end()) {
+        return std::make_unique<Version>(current_.load()->server);
+    }
+
+    auto version = std::move(*freshest);
+    spare_.erase(freshest);
+    const uint64_t current_number = current_.load()->number;
+    for (uint64_t number = version->number + 1; number <= current_number; ++number) {
+        try {
+            log_[number - log_first_number_](version->server);
+        } catch (...) {
+            // Исключение уже было передано вызывающему при первом применении
+        }
+    }
+    return version;
+}
+
+void SnapshotSearchServer::WaitForAcquiringReaders() {
+    // Два переключения эпохи: после них любой читатель, ещё не отметившийся
+    // в версии, прочитает current_ уже после публикации
+    for (int i = 0; i < 2; ++i) {
+        const auto& acquiring = acquiring_[epoch_.fetch_add(1) & 1].count;
+        while (acquiring.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void SnapshotSearchServer::ReclaimSpare() {
+    // Из свободных версий нужна только самая свежая, занятые ждут читателей
+    const Version* freshest = nullptr;
+    for (const auto& version : spare_) {
+        if (version->readers.load(std::memory_order_acquire) == 0 && CanCatchUp(*version)
+            && (!freshest || version->number > freshest->number)) {
+            freshest = version.get();
+        }
+    }
+    spare_.erase(std::remove_if(spare_.begin(), spare_.end(),
+                                [freshest](const std::unique_ptr<Version>& version) {
+                                    return version.get() != freshest
+                                           && version->readers.load(std::memory_order_acquire) == 0;
+                                }),
+                 spare_.end());
+
+    // Журнал нужен начиная с изменения, следующего за самой старой версией, которую можно догнать
+    uint64_t first_needed = current_.load()->number + 1;
+    for (const auto& version : spare_) {
+        if (CanCatchUp(*version)) {
+            first_needed = std::min(first_needed, version->number + 1);
+        }
+    }
+    while (log_first_number_ < first_needed) {
+        log_.pop_front();
+        ++log_first_number_;
+    }
+}
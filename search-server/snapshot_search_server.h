@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// SearchServer, который можно читать во время записи.
+// Читатели берут неизменяемую версию индекса без блокировок, писатели (по одному за раз)
+// готовят следующую версию и атомарно публикуют её. Старая версия освобождается,
+// когда её отпускает последний читатель.
+//
+// Чтобы не копировать весь индекс на каждое изменение, снятые с публикации версии
+// остаются в запасе, а изменения — в журнале. Писатель берёт самую свежую запасную
+// версию без читателей и догоняет её до текущей, повторяя изменения из журнала.
+// Занятые версии ждут, пока читатели их отпустят, и догоняются позже, поэтому при
+// постоянном чтении копировать приходится, только когда читают все запасные версии.
+// Версия, отставшая больше чем на SNAPSHOT_MAX_CATCH_UP изменений, не догоняется
+// и освобождается, когда её отпустят.
+constexpr uint64_t SNAPSHOT_MAX_CATCH_UP = 1024;
+
+class SnapshotSearchServer {
+    struct Version;
+
+public:
+    // Читающий доступ к одной версии индекса. Пока объект жив, версия не освобождается
+    class Snapshot {
+    public:
+        Snapshot() = default;
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot(Snapshot&& other) noexcept;
+        Snapshot& operator=(Snapshot&& other) noexcept;
+        ~Snapshot();
+
+        const SearchServer& operator*() const;
+        const SearchServer* operator->() const;
+
+        // Номер версии, растёт с каждой публикацией
+        uint64_t GetVersion() const;
+
+    private:
+        friend class SnapshotSearchServer;
+
+        explicit Snapshot(Version* version);
+
+        Version* version_ = nullptr;
+    };
+
+    // Изменение индекса. Может быть применено повторно к другой копии индекса,
+    // поэтому должно владеть своими данными и давать одинаковый результат
+    using Update = std::function<void(SearchServer&)>;
+
+    template <typename StringContainer>
+    explicit SnapshotSearchServer(const StringContainer& stop_words);
+    explicit SnapshotSearchServer(const std::string_view stop_words_text);
+
+    SnapshotSearchServer(const SnapshotSearchServer&) = delete;
+    SnapshotSearchServer& operator=(const SnapshotSearchServer&) = delete;
+    ~SnapshotSearchServer();
+
+    Snapshot GetSnapshot() const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<DocumentInput>& documents);
+    void RemoveDocument(int document_id);
+    // Применяет несколько изменений одной публикацией
+    void ApplyUpdate(Update update);
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const {
+        return GetSnapshot()->FindTopDocuments(std::forward<Args>(args)...);
+    }
+
+    int GetDocumentCount() const;
+
+private:
+    struct Version {
+        explicit Version(SearchServer server)
+            : server(std::move(server)) {
+        }
+
+        SearchServer server;
+        uint64_t number = 0;
+        std::atomic<int64_t> readers{0};
+    };
+
+    // Счётчик читателей, которые прочитали current_, но ещё не отметились в версии.
+    // Счётчиков два, по чётности эпохи, чтобы писатель дожидался только старых читателей.
+    struct alignas(64) AcquireCounter {
+        std::atomic<int64_t> count{0};
+    };
+
+    std::atomic<Version*> current_;
+    mutable std::array<AcquireCounter, 2> acquiring_;
+    std::atomic<uint64_t> epoch_{0};
+
+    std::mutex write_mutex_;
+    // Снятые с публикации версии
+    std::vector<std::unique_ptr<Version>> spare_;
+    // log_[i] превращает версию с номером log_first_number_ + i - 1 в следующую
+    std::deque<Update> log_;
+    uint64_t log_first_number_ = 1;
+
+    void Publish(Update update);
+    // Можно ли догнать версию до текущей по журналу
+    bool CanCatchUp(const Version& version) const;
+    std::unique_ptr<Version> MakeWritableVersion();
+    void WaitForAcquiringReaders();
+    // Освобождает ненужные запасные версии и начало журнала, которое им уже не понадобится
+    void ReclaimSpare();
+};
+
+template <typename StringContainer>
+SnapshotSearchServer::SnapshotSearchServer(const StringContainer& stop_words)
+    : current_(new Version(SearchServer(stop_words))) {
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+
+#include "stop_word_set.h"
+
+using namespace std;
+
+namespace {
+
+// Сколько сдвигов пробуется для корзины и сколько солей для всей таблицы
+constexpr uint32_t MAX_DISPLACEMENT = 1u << 20;
+constexpr uint64_t MAX_SALT = 64;
+
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+} // namespace
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words)
+    : words_(words.begin(), words.end()) {
+    for (const std::string& word : words_) {
+        lengths_ |= GetLengthBit(word.size());
+        if (word.empty()) {
+            continue;
+        }
+        for (const size_t bit : GetFilterBits(word)) {
+            filter_[bit / 64] |= uint64_t{1} << bit % 64;
+        }
+    }
+    for (uint64_t salt = 0; !BuildTable(salt); ++salt) {
+        if (salt == MAX_SALT) {
+            throw std::logic_error("Cannot build stop word table"s);
+        }
+    }
+}
+
+bool StopWordSet::Contains(std::string_view word) const {
+    if ((lengths_ & GetLengthBit(word.size())) == 0) {
+        return false;
+    }
+    // Пустое слово отсекается только по длине: символов для фильтра у него нет
+    if (!word.empty()) {
+        for (const size_t bit : GetFilterBits(word)) {
+            if ((filter_[bit / 64] >> bit % 64 & 1) == 0) {
+                return false;
+            }
+        }
+    }
+    const uint64_t hash = GetHash(word);
+    return words_[slots_[GetSlot(hash, displacements_[hash % displacements_.size()])]] == word;
+}
+
+std::vector<std::string>::const_iterator StopWordSet::begin() const {
+    return words_.begin();
+}
+
+std::vector<std::string>::const_iterator StopWordSet::end() const {
+    return words_.end();
+}
+
+size_t StopWordSet::size() const {
+    return words_.size();
+}
+
+bool StopWordSet::BuildTable(uint64_t salt) {
+    salt_ = salt;
+    const size_t word_count = words_.size();
+    // В среднем два слова на корзину
+    displacements_.assign(word_count / 2 + 1, 0);
+    slots_.assign(word_count, 0);
+
+    vector<uint64_t> hashes(word_count);
+    vector<vector<uint32_t>> buckets(displacements_.size());
+    for (uint32_t i = 0; i < word_count; ++i) {
+        hashes[i] = GetHash(words_[i]);
+        buckets[hashes[i] % buckets.size()].push_back(i);
+    }
+    // Большие корзины размещаются первыми, пока свободных слотов много
+    vector<uint32_t> order(buckets.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    vector<bool> taken(word_count, false);
+    vector<size_t> bucket_slots;
+    for (const uint32_t bucket : order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t displacement = 0; displacement < MAX_DISPLACEMENT && !placed; ++displacement) {
+            bucket_slots.clear();
+            placed = true;
+            for (const uint32_t word : buckets[bucket]) {
+                const size_t slot = GetSlot(hashes[word], displacement);
+                if (taken[slot] || find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end()) {
+                    placed = false;
+                    break;
+                }
+                bucket_slots.push_back(slot);
+            }
+            if (placed) {
+                displacements_[bucket] = displacement;
+                for (size_t i = 0; i < bucket_slots.size(); ++i) {
+                    taken[bucket_slots[i]] = true;
+                    slots_[bucket_slots[i]] = buckets[bucket][i];
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t StopWordSet::GetHash(std::string_view word) const {
+    return Mix(std::hash<std::string_view>{}(word) ^ salt_);
+}
+
+size_t StopWordSet::GetSlot(uint64_t hash, uint32_t displacement) const {
+    return Mix(hash + displacement * 0x9e3779b97f4a7c15ULL) % slots_.size();
+}
+
+std::array<size_t, 2> StopWordSet::GetFilterBits(std::string_view word) {
+    const auto byte = [word](size_t i) {
+        return static_cast<uint64_t>(static_cast<unsigned char>(word[i]));
+    };
+    const uint64_t key = (word.size() | byte(0) << 16 | byte(word.size() / 2) << 24 | byte(word.size() - 1) << 32) * 0x9e3779b97f4a7c15ULL;
+    return {key >> 52, key >> 40 & (FILTER_BITS - 1)};
+}
+
+uint64_t StopWordSet::GetLengthBit(size_t length) {
+    return uint64_t{1} << std::min<size_t>(length, 63);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемое множество стоп-слов. Большинство обычных слов отсекается без хеширования:
+// сначала по длине, затем маленьким фильтром Блума по длине, первому, среднему и последнему
+// символам. Прошедшее фильтры слово ищется в минимальной совершенной хеш-таблице
+// (hash and displace): у каждого стоп-слова свой слот, поэтому сравнивается одна строка
+class StopWordSet {
+public:
+    StopWordSet() = default;
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(std::string_view word) const;
+
+    // Слова в порядке возрастания
+    std::vector<std::string>::const_iterator begin() const;
+    std::vector<std::string>::const_iterator end() const;
+    size_t size() const;
+
+private:
+    // 512 байт: при нескольких сотнях стоп-слов фильтр пропускает около 5% обычных слов
+    static constexpr size_t FILTER_BITS = 4096;
+
+    std::vector<std::string> words_;
+    // Бит i установлен, если есть стоп-слово длины i, длины от 63 делят последний бит
+    uint64_t lengths_ = 0;
+    std::array<uint64_t, FILTER_BITS / 64> filter_ = {};
+    // Соль хеша слова, подбирается при построении, если таблица не строится
+    uint64_t salt_ = 0;
+    // Сдвиг каждой корзины и номер слова в каждом слоте
+    std::vector<uint32_t> displacements_;
+    std::vector<uint32_t> slots_;
+
+    bool BuildTable(uint64_t salt);
+    uint64_t GetHash(std::string_view word) const;
+    size_t GetSlot(uint64_t hash, uint32_t displacement) const;
+    // Два бита фильтра Блума для непустого слова
+    static std::array<size_t, 2> GetFilterBits(std::string_view word);
+    static uint64_t GetLengthBit(size_t length);
+};
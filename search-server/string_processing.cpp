@@ -1,18 +1,137 @@
+#include <cstring>
+
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(std::string_view str) {
-    std::vector<std::string_view> result;
-    const int64_t pos_end = str.npos;
-    while (true) {
-        int64_t space = str.find(' ');
-        result.push_back(space == pos_end ? str.substr() :
-                         str.substr(0, space));
-        if (space == pos_end) {
-            break;
-        } else {
-            ++space;
-            str.remove_prefix(space);
+#if defined(__x86_64__) || defined(__i386__)
+#define STRING_PROCESSING_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+
+// Управляющими считаются те же символы, что и в SearchServer::IsValidWord: c >= 0 && c < ' '
+void ScanBlockScalar(const char* block, uint64_t& spaces, uint64_t& controls) {
+    spaces = 0;
+    controls = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        const char c = block[i];
+        spaces |= static_cast<uint64_t>(c == ' ') << i;
+        controls |= static_cast<uint64_t>(c >= '\0' && c < ' ') << i;
+    }
+}
+
+#ifdef STRING_PROCESSING_X86
+
+__attribute__((target("sse2")))
+void ScanBlockSse2(const char* block, uint64_t& spaces, uint64_t& controls) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    spaces = 0;
+    controls = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        // Сравнения знаковые, поэтому байты от 0x80 не считаются управляющими
+        const __m128i control = _mm_and_si128(_mm_cmpgt_epi8(bytes, minus_one), _mm_cmplt_epi8(bytes, space));
+        spaces |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)))) << i;
+        controls |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(control))) << i;
+    }
+}
+
+__attribute__((target("avx2")))
+void ScanBlockAvx2(const char* block, uint64_t& spaces, uint64_t& controls) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    spaces = 0;
+    controls = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        const __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, minus_one), _mm256_cmpgt_epi8(space, bytes));
+        spaces |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)))) << i;
+        controls |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(control))) << i;
+    }
+}
+
+#endif
+
+using ScanBlockFunction = void (*)(const char* block, uint64_t& spaces, uint64_t& controls);
+
+ScanBlockFunction ChooseScanBlock() {
+#ifdef STRING_PROCESSING_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return ScanBlockAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ScanBlockSse2;
+    }
+#endif
+    return ScanBlockScalar;
+}
+
+// Выбор делается при первом вызове, а не при инициализации глобальных переменных,
+// поэтому токенизатор работает и в инициализаторах глобальных объектов других файлов
+ScanBlockFunction GetScanBlock() {
+    static const ScanBlockFunction scan_block = ChooseScanBlock();
+    return scan_block;
+}
+
+} // namespace
+
+WordTokenizer::WordTokenizer(std::string_view text)
+    : text_(text)
+    , scan_block_(GetScanBlock()) {
+}
+
+bool WordTokenizer::Next(std::string_view& word, bool& has_control) {
+    if (finished_) {
+        return false;
+    }
+    has_control = false;
+    size_t position = word_start_;
+    while (position < text_.size()) {
+        const size_t block_start = position & ~(BLOCK_SIZE - 1);
+        if (block_start != block_start_) {
+            LoadBlock(block_start);
+        }
+        const size_t shift = position - block_start;
+        const uint64_t spaces = spaces_ >> shift;
+        const uint64_t controls = controls_ >> shift;
+        if (spaces != 0) {
+            const size_t length = __builtin_ctzll(spaces);
+            has_control |= (controls & ((uint64_t{1} << length) - 1)) != 0;
+            const size_t word_end = position + length;
+            word = text_.substr(word_start_, word_end - word_start_);
+            word_start_ = word_end + 1;
+            return true;
         }
+        has_control |= controls != 0;
+        position = block_start + BLOCK_SIZE;
+    }
+    // После последнего пробела остаётся ещё одно слово, возможно пустое
+    word = text_.substr(word_start_);
+    finished_ = true;
+    return true;
+}
+
+void WordTokenizer::LoadBlock(size_t block_start) {
+    block_start_ = block_start;
+    const size_t length = text_.size() - block_start;
+    if (length >= BLOCK_SIZE) {
+        scan_block_(text_.data() + block_start, spaces_, controls_);
+        return;
     }
+    // Последний неполный блок дополняется обычными символами
+    char block[BLOCK_SIZE];
+    std::memset(block, 'a', BLOCK_SIZE);
+    std::memcpy(block, text_.data() + block_start, length);
+    scan_block_(block, spaces_, controls_);
+}
+
+std::vector<std::string_view> SplitIntoWords(std::string_view str) {
+    std::vector<std::string_view> result;
+    ForEachWord(str, [&result](std::string_view word, bool) {
+        result.push_back(word);
+    });
     return result;
 }
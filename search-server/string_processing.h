@@ -1,9 +1,49 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <set>
 
+// Разбивает текст на слова по каждому пробелу, как SplitIntoWords, но без выделения памяти:
+// подряд идущие пробелы дают пустые слова, пустой текст — одно пустое слово.
+// Текст просматривается блоками по 64 байта, за один проход по блоку находятся и пробелы,
+// и управляющие символы, на x86 — с помощью AVX2 или SSE2, если процессор их поддерживает
+class WordTokenizer {
+public:
+    explicit WordTokenizer(std::string_view text);
+
+    // Записывает следующее слово и признак того, что в нём есть символы с кодами от 0 до 31.
+    // Возвращает false, когда слова закончились
+    bool Next(std::string_view& word, bool& has_control);
+
+private:
+    using ScanBlockFunction = void (*)(const char* block, uint64_t& spaces, uint64_t& controls);
+
+    std::string_view text_;
+    ScanBlockFunction scan_block_;
+    size_t word_start_ = 0;
+    bool finished_ = false;
+    // Битовые маски пробелов и управляющих символов блока, начинающегося с block_start_
+    size_t block_start_ = std::string_view::npos;
+    uint64_t spaces_ = 0;
+    uint64_t controls_ = 0;
+
+    void LoadBlock(size_t block_start);
+};
+
+// Вызывает callback(word, has_control) для каждого слова текста
+template <typename Callback>
+void ForEachWord(std::string_view text, Callback callback) {
+    WordTokenizer tokenizer(text);
+    std::string_view word;
+    bool has_control = false;
+    while (tokenizer.Next(word, has_control)) {
+        callback(word, has_control);
+    }
+}
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
 template <typename StringContainer>
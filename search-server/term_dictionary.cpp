@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <functional>
+
+#include "term_dictionary.h"
+
+using namespace std;
+
+TermId TermDictionary::Intern(std::string_view word) {
+    if ((words_.size() + 1) * 2 > slots_.size()) {
+        Rehash(std::max<size_t>(16, slots_.size() * 2));
+    }
+    const size_t slot = FindSlot(word);
+    if (slots_[slot] != NO_TERM) {
+        return slots_[slot];
+    }
+    const TermId term = static_cast<TermId>(words_.size());
+    words_.emplace_back(word);
+    slots_[slot] = term;
+    return term;
+}
+
+TermId TermDictionary::Find(std::string_view word) const {
+    if (slots_.empty()) {
+        return NO_TERM;
+    }
+    return slots_[FindSlot(word)];
+}
+
+std::string_view TermDictionary::GetWord(TermId term) const {
+    return words_.at(term);
+}
+
+size_t TermDictionary::GetTermCount() const {
+    return words_.size();
+}
+
+size_t TermDictionary::FindSlot(std::string_view word) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(word) & mask;
+    while (slots_[slot] != NO_TERM && words_[slots_[slot]] != word) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+    slots_.assign(slot_count, NO_TERM);
+    for (TermId term = 0; term < words_.size(); ++term) {
+        slots_[FindSlot(words_[term])] = term;
+    }
+}
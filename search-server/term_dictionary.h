@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using TermId = uint32_t;
+
+constexpr TermId NO_TERM = UINT32_MAX;
+
+// Присваивает каждому слову плотный номер TermId в порядке первого появления.
+// Слова хранятся в deque, поэтому string_view на них не инвалидируются при добавлении.
+class TermDictionary {
+public:
+    TermId Intern(std::string_view word);
+
+    // Возвращает NO_TERM, если слово не встречалось
+    TermId Find(std::string_view word) const;
+
+    std::string_view GetWord(TermId term) const;
+
+    size_t GetTermCount() const;
+
+private:
+    std::deque<std::string> words_;
+    // Открытая адресация: в слоте хранится номер слова или NO_TERM
+    std::vector<TermId> slots_;
+
+    size_t FindSlot(std::string_view word) const;
+    void Rehash(size_t slot_count);
+};
@@ -0,0 +1,1249 @@
+// Проверки того, что ускоренные пути SearchServer дают ту же выдачу, что и эталонные,
+// на случайных корпусах с удалениями и разными top_k.
+// Сборка из каталога search-server:
+//   g++ -std=c++17 -O2 -I. tests/search_server_tests.cpp $(ls *.cpp | grep -v main.cpp) -o search_server_tests -ltbb -lpthread
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "concurrent_map.h"
+#include "durable_search_server.h"
+#include "index_file.h"
+#include "operation_log.h"
+#include "process_queries.h"
+#include "request_queue.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+#include "stop_word_set.h"
+#include "snapshot_search_server.h"
+#include "string_processing.h"
+#include "top_documents.h"
+#include "test_framework.h"
+#include "thread_pool.h"
+
+using namespace std::string_literals;
+using namespace std;
+
+namespace {
+
+const vector<size_t> TOP_KS = {1, 5, 20, 1000};
+
+vector<string> MakeDictionary(mt19937& generator, int word_count) {
+    vector<string> dictionary;
+    for (int i = 0; i < word_count; ++i) {
+        string word;
+        const int length = uniform_int_distribution<>(1, 5)(generator);
+        for (int j = 0; j < length; ++j) {
+            word.push_back(static_cast<char>('a' + generator() % 8));
+        }
+        dictionary.push_back(move(word));
+    }
+    return dictionary;
+}
+
+string MakeText(mt19937& generator, const vector<string>& dictionary, int max_word_count, double minus_prob = 0) {
+    string text;
+    const int word_count = uniform_int_distribution<>(0, max_word_count)(generator);
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            text += ' ';
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text += '-';
+        }
+        text += dictionary[generator() % dictionary.size()];
+    }
+    return text;
+}
+
+vector<string> MakeQueries(mt19937& generator, const vector<string>& dictionary, int query_count) {
+    vector<string> queries;
+    while (static_cast<int>(queries.size()) < query_count) {
+        string query = MakeText(generator, dictionary, 12, 0.1);
+        if (!query.empty()) {
+            queries.push_back(move(query));
+        }
+    }
+    return queries;
+}
+
+string ResultKey(const vector<Document>& documents) {
+    ostringstream out;
+    out.precision(17);
+    for (const Document& document : documents) {
+        out << document.id << ':' << document.relevance << '/' << document.rating << ';';
+    }
+    return out.str();
+}
+
+// Документы, релевантность которых отличается меньше чем на RELEVANCE_EQUALITY_TRESHOLD, упорядочиваются
+// по рейтингу, и при цепочке почти равных значений разные пути могут расставить их по-разному.
+// Поэтому выдачи сравниваются по релевантности на каждой позиции с небольшим допуском
+void AssertSameRelevances(const vector<Document>& documents, const vector<Document>& expected, const string& hint) {
+    AssertEqual(documents.size(), expected.size(), hint);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        Assert(abs(documents[i].relevance - expected[i].relevance) < 10 * RELEVANCE_EQUALITY_TRESHOLD,
+               hint + ", position "s + to_string(i));
+    }
+}
+
+// Всё наблюдаемое состояние сервера: документы, частоты слов и выдача по запросам
+string Dump(const SearchServer& search_server, const vector<string>& queries) {
+    ostringstream out;
+    out.precision(17);
+    out << search_server.GetDocumentCount() << '\n';
+    for (const int document_id : search_server) {
+        out << document_id << ':';
+        for (const auto& [word, frequency] : search_server.GetWordFrequencies(document_id)) {
+            out << word << '=' << frequency << ',';
+        }
+        out << '\n';
+    }
+    for (const string& query : queries) {
+        out << ResultKey(search_server.FindTopDocuments(query, [](int, DocumentStatus, int) { return true; }, 1000)) << '\n';
+    }
+    return out.str();
+}
+
+SearchServer MakeServer(mt19937& generator, const vector<string>& dictionary, int document_count) {
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, MakeText(generator, dictionary, 30), DocumentStatus(generator() % 3), {int(generator() % 20)});
+        if (generator() % 5 == 0) {
+            search_server.RemoveDocument(generator() % (i + 1));
+        }
+    }
+    return search_server;
+}
+
+}  // namespace
+
+// Токенизатор режет текст так же, как поиск пробелов по одному, и так же находит управляющие символы
+void TestWordTokenizer() {
+    mt19937 generator(1);
+    const string alphabet = "  ab\t\n\x01\x1f\x7f\x80\xff-z"s;
+    for (int iteration = 0; iteration < 20000; ++iteration) {
+        const size_t length = generator() % 300;
+        string buffer(length + 64, 'x');
+        for (char& c : buffer) {
+            const int kind = generator() % 10;
+            c = kind < 2 ? ' ' : kind < 3 ? alphabet[generator() % alphabet.size()] : kind < 4 ? static_cast<char>(generator()) : static_cast<char>('a' + generator() % 26);
+        }
+        // Текст начинается не с начала буфера, за его концом — посторонние символы
+        const size_t offset = generator() % 64;
+        const string_view text(buffer.data() + offset, min(length, buffer.size() - offset));
+
+        vector<string_view> expected;
+        for (string_view rest = text;;) {
+            const size_t space = rest.find(' ');
+            expected.push_back(rest.substr(0, space));
+            if (space == string_view::npos) {
+                break;
+            }
+            rest.remove_prefix(space + 1);
+        }
+        size_t index = 0;
+        ForEachWord(text, [&](string_view word, bool has_control) {
+            ASSERT(index < expected.size());
+            ASSERT(word.data() == expected[index].data() && word.size() == expected[index].size());
+            ASSERT_EQUAL(has_control, any_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; }));
+            ++index;
+        });
+        ASSERT_EQUAL(index, expected.size());
+        ASSERT(SplitIntoWords(text) == expected);
+    }
+    ASSERT_EQUAL(SplitIntoWords(""sv).size(), 1u);
+    ASSERT_EQUAL(SplitIntoWords("a  b "sv).size(), 4u);
+}
+
+// MaxScore отбрасывает документы, которые не попадут в top_k, и не должен менять выдачу
+void TestMaxScoreMatchesExhaustive() {
+    mt19937 generator(7);
+    for (int round = 0; round < 3; ++round) {
+        const auto dictionary = MakeDictionary(generator, 200 + round * 300);
+        const SearchServer search_server = MakeServer(generator, dictionary, 3000);
+        const auto predicate = [](int, DocumentStatus status, int rating) {
+            return status != DocumentStatus::BANNED && rating % 4 != 0;
+        };
+        for (const string& query : MakeQueries(generator, dictionary, 100)) {
+            for (const size_t top_k : TOP_KS) {
+                AssertSameRelevances(search_server.FindTopDocuments(query, predicate, top_k, RetrievalMode::MAX_SCORE),
+                                     search_server.FindTopDocuments(query, predicate, top_k), query);
+                AssertSameRelevances(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_k, RetrievalMode::MAX_SCORE),
+                                     search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_k), query);
+            }
+        }
+    }
+}
+
+// Параллельный поиск совпадает с последовательным
+void TestParallelFindMatchesSequential() {
+    mt19937 generator(13);
+    const auto dictionary = MakeDictionary(generator, 400);
+    const SearchServer search_server = MakeServer(generator, dictionary, 4000);
+    for (const string& query : MakeQueries(generator, dictionary, 100)) {
+        for (const size_t top_k : TOP_KS) {
+            for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT}) {
+                AssertSameRelevances(search_server.FindTopDocuments(execution::par, query, status, top_k),
+                                     search_server.FindTopDocuments(execution::seq, query, status, top_k), query);
+            }
+        }
+    }
+}
+
+// Параллельный поиск внутри предиката параллельного поиска не портит накопители внешнего,
+// даже если поток, ожидая вложенный поиск, берёт другие диапазоны внешнего
+void TestNestedParallelFindMatchesSequential() {
+    mt19937 generator(31);
+    const auto dictionary = MakeDictionary(generator, 300);
+    const SearchServer search_server = MakeServer(generator, dictionary, 40000);
+    const auto queries = MakeQueries(generator, dictionary, 10);
+    for (const string& query : queries) {
+        atomic<int> call_count = 0;
+        const auto predicate = [&](int, DocumentStatus status, int) {
+            if (call_count.fetch_add(1) % 2000 == 0) {
+                search_server.FindTopDocuments(execution::par, queries[0]);
+            }
+            return status == DocumentStatus::ACTUAL;
+        };
+        AssertSameRelevances(search_server.FindTopDocuments(execution::par, query, predicate, 1000),
+                             search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, 1000), query);
+    }
+}
+
+// Пакетное добавление даёт тот же индекс и ту же ошибку, что и добавление по одному
+void TestAddDocumentsMatchesAddDocument() {
+    mt19937 generator(3);
+    const auto dictionary = MakeDictionary(generator, 500);
+    const auto queries = MakeQueries(generator, dictionary, 30);
+    for (int trial = 0; trial < 4; ++trial) {
+        SearchServer one_by_one(dictionary[0]);
+        SearchServer batch(dictionary[0]);
+        SearchServer parallel_batch(dictionary[0]);
+        int next_id = 0;
+        for (int step = 0; step < 4; ++step) {
+            const int document_count = generator() % 2000;
+            vector<string> texts;
+            for (int i = 0; i < document_count; ++i) {
+                texts.push_back(MakeText(generator, dictionary, 30));
+            }
+            vector<DocumentInput> documents;
+            for (int i = 0; i < document_count; ++i) {
+                int id = next_id++;
+                // Во второй половине проб попадаются некорректные документы
+                if (trial >= 2 && generator() % 1000 == 0) {
+                    id = generator() % 3 == 0 ? -5 : static_cast<int>(generator() % next_id);
+                }
+                if (trial >= 2 && generator() % 1500 == 0) {
+                    texts[i] += " x\x03"s;
+                }
+                documents.push_back({id, texts[i], DocumentStatus(generator() % 4), {int(generator() % 9)}});
+            }
+            string one_by_one_error;
+            string batch_error;
+            string parallel_batch_error;
+            try {
+                for (const DocumentInput& document : documents) {
+                    one_by_one.AddDocument(document.id, document.text, document.status, document.ratings);
+                }
+            } catch (const exception& e) {
+                one_by_one_error = e.what();
+            }
+            try {
+                batch.AddDocuments(documents);
+            } catch (const exception& e) {
+                batch_error = e.what();
+            }
+            try {
+                parallel_batch.AddDocuments(execution::par, documents);
+            } catch (const exception& e) {
+                parallel_batch_error = e.what();
+            }
+            ASSERT_EQUAL(batch_error, one_by_one_error);
+            ASSERT_EQUAL(parallel_batch_error, one_by_one_error);
+            for (int i = 0; i < 100; ++i) {
+                const int id = generator() % (next_id + 1);
+                one_by_one.RemoveDocument(id);
+                batch.RemoveDocument(id);
+                parallel_batch.RemoveDocument(execution::par, id);
+            }
+        }
+        const string expected = Dump(one_by_one, queries);
+        ASSERT_EQUAL(Dump(batch, queries), expected);
+        ASSERT_EQUAL(Dump(parallel_batch, queries), expected);
+    }
+}
+
+// Шардированный сервер отвечает так же, как один сервер с теми же документами
+void TestShardedMatchesUnsharded() {
+    mt19937 generator(5);
+    const auto dictionary = MakeDictionary(generator, 400);
+    for (const size_t shard_count : {1, 2, 3, 7}) {
+        SearchServer search_server(dictionary[0]);
+        ShardedSearchServer sharded(dictionary[0], shard_count);
+        vector<string> texts;
+        for (int i = 0; i < 3000; ++i) {
+            texts.push_back(MakeText(generator, dictionary, 20));
+        }
+        vector<DocumentInput> documents;
+        for (int i = 0; i < 3000; ++i) {
+            documents.push_back({i * 3, texts[i], DocumentStatus(generator() % 4), {int(generator() % 9)}});
+        }
+        search_server.AddDocuments(documents);
+        sharded.AddDocuments(documents);
+        for (int i = 0; i < 200; ++i) {
+            const int id = generator() % 9000;
+            search_server.RemoveDocument(id);
+            sharded.RemoveDocument(id);
+        }
+        ASSERT_EQUAL(sharded.GetDocumentCount(), search_server.GetDocumentCount());
+        for (const string& query : MakeQueries(generator, dictionary, 100)) {
+            for (const size_t top_k : TOP_KS) {
+                AssertSameRelevances(sharded.FindTopDocuments(query, DocumentStatus::ACTUAL, top_k),
+                                     search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_k), query);
+            }
+        }
+    }
+}
+
+// Некорректный документ пакета останавливает добавление во всех шардах: добавляются
+// те же документы, что у SearchServer::AddDocuments и у AddDocument по одному
+void TestShardedAddDocumentsStopsAtInvalid() {
+    const auto ids = [](const auto& search_server) {
+        set<int> result;
+        for (const Document& document : search_server.FindTopDocuments("cat"sv, DocumentStatus::ACTUAL, 1000)) {
+            result.insert(document.id);
+        }
+        return result;
+    };
+    vector<DocumentInput> valid;
+    for (int id = 0; id < 5; ++id) {
+        valid.push_back({id * 10, "cat"sv, DocumentStatus::ACTUAL, {1}});
+    }
+    // Первый некорректный документ — на позиции 4, за ним документы всех шардов
+    const vector<vector<DocumentInput>> batches = {
+        {{1, "cat"sv, DocumentStatus::ACTUAL, {1}}, {2, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {3, "cat"sv, DocumentStatus::ACTUAL, {1}}, {4, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {5, "cat \x01"sv, DocumentStatus::ACTUAL, {1}}, {6, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {7, "cat"sv, DocumentStatus::ACTUAL, {1}}, {8, "cat"sv, DocumentStatus::ACTUAL, {1}}},
+        {{1, "cat"sv, DocumentStatus::ACTUAL, {1}}, {2, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {3, "cat"sv, DocumentStatus::ACTUAL, {1}}, {4, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {20, "cat"sv, DocumentStatus::ACTUAL, {1}}, {6, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {7, "cat"sv, DocumentStatus::ACTUAL, {1}}, {-8, "cat \x01"sv, DocumentStatus::ACTUAL, {1}}},
+        {{1, "cat"sv, DocumentStatus::ACTUAL, {1}}, {2, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {3, "cat"sv, DocumentStatus::ACTUAL, {1}}, {4, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {2, "cat"sv, DocumentStatus::ACTUAL, {1}}, {6, "cat"sv, DocumentStatus::ACTUAL, {1}},
+         {7, "cat"sv, DocumentStatus::ACTUAL, {1}}, {8, "cat"sv, DocumentStatus::ACTUAL, {1}}},
+    };
+    for (const auto& batch : batches) {
+        for (const size_t shard_count : {1, 3, 4}) {
+            ShardedSearchServer sharded("and"sv, shard_count);
+            SearchServer batched("and"s);
+            SearchServer single("and"s);
+            sharded.AddDocuments(valid);
+            batched.AddDocuments(valid);
+            single.AddDocuments(valid);
+            ASSERT_THROWS(sharded.AddDocuments(batch), invalid_argument);
+            ASSERT_THROWS(batched.AddDocuments(batch), invalid_argument);
+            const auto add_one_by_one = [&] {
+                for (const DocumentInput& document : batch) {
+                    single.AddDocument(document.id, document.text, document.status, document.ratings);
+                }
+            };
+            ASSERT_THROWS(add_one_by_one(), invalid_argument);
+            ASSERT_EQUAL(sharded.GetDocumentCount(), 9);
+            ASSERT(ids(sharded) == ids(batched));
+            ASSERT(ids(sharded) == ids(single));
+        }
+    }
+}
+
+// Пакет запросов совпадает с запросами по одному
+void TestFindTopDocumentsBatchMatchesSingleQueries() {
+    mt19937 generator(11);
+    const auto dictionary = MakeDictionary(generator, 300);
+    const SearchServer search_server = MakeServer(generator, dictionary, 3000);
+    const auto queries = MakeQueries(generator, dictionary, 200);
+    const vector<string_view> query_views(queries.begin(), queries.end());
+    for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED}) {
+        for (const size_t top_k : TOP_KS) {
+            const auto parallel_results = search_server.FindTopDocumentsBatch(execution::par, queries, status, top_k);
+            const auto sequential_results = search_server.FindTopDocumentsBatch(execution::seq, query_views, status, top_k);
+            ASSERT_EQUAL(parallel_results.size(), queries.size());
+            ASSERT_EQUAL(sequential_results.size(), queries.size());
+            for (size_t i = 0; i < queries.size(); ++i) {
+                const string expected = ResultKey(search_server.FindTopDocuments(queries[i], status, top_k));
+                ASSERT_EQUAL(ResultKey(parallel_results[i]), expected);
+                ASSERT_EQUAL(ResultKey(sequential_results[i]), expected);
+            }
+        }
+    }
+    const auto batched = ProcessQueriesBatched(search_server, queries);
+    const auto single = ProcessQueries(search_server, queries);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        ASSERT_EQUAL(ResultKey(batched[i]), ResultKey(single[i]));
+    }
+}
+
+// Индекс, сохранённый и загруженный из файла, неотличим от исходного
+void TestSaveIndexRoundTrip() {
+    mt19937 generator(17);
+    const auto dictionary = MakeDictionary(generator, 300);
+    const auto queries = MakeQueries(generator, dictionary, 30);
+    const SearchServer search_server = MakeServer(generator, dictionary, 3000);
+    const string path = (filesystem::temp_directory_path() / "search_server_tests_index.bin"s).string();
+    search_server.SaveIndex(path);
+    {
+        SearchServer loaded = SearchServer::LoadIndex(path);
+        ASSERT_EQUAL(Dump(loaded, queries), Dump(search_server, queries));
+
+        // Изменения поверх загруженного индекса: удаления из отображённого сегмента,
+        // новые документы и перестроение сегмента
+        SearchServer changed = search_server;
+        for (int i = 0; i < 3000; ++i) {
+            if (generator() % 3 == 0) {
+                const int id = generator() % (3000 + i);
+                loaded.RemoveDocument(id);
+                changed.RemoveDocument(id);
+            } else {
+                const string text = MakeText(generator, dictionary, 30);
+                loaded.AddDocument(3000 + i, text, DocumentStatus::ACTUAL, {i % 7});
+                changed.AddDocument(3000 + i, text, DocumentStatus::ACTUAL, {i % 7});
+            }
+        }
+        ASSERT_EQUAL(Dump(loaded, queries), Dump(changed, queries));
+    }
+    filesystem::remove(path);
+}
+
+// После освобождения номеров удалённых документов сервер неотличим от сервера,
+// в который добавляли только оставшиеся документы
+void TestRemovedOrdinalsAreReclaimed() {
+    mt19937 generator(23);
+    const auto dictionary = MakeDictionary(generator, 500);
+    const auto queries = MakeQueries(generator, dictionary, 50);
+    vector<string> texts;
+    for (int i = 0; i < 30000; ++i) {
+        texts.push_back(MakeText(generator, dictionary, 20));
+    }
+
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < 20000; ++i) {
+        search_server.AddDocument(i, texts[i], DocumentStatus(i % 3), {i % 11});
+    }
+    const int watched_id = 19999;
+    const auto& watched_freqs = search_server.GetWordFrequencies(watched_id);
+    const auto watched_copy = watched_freqs;
+
+    vector<bool> is_removed(texts.size(), false);
+    for (int i = 0; i < 12000; ++i) {
+        const int id = generator() % 19999;
+        is_removed[id] = true;
+        if (i % 2 == 0) {
+            search_server.RemoveDocument(id);
+        } else {
+            search_server.RemoveDocument(execution::par, id);
+        }
+    }
+    for (int i = 20000; i < 30000; ++i) {
+        search_server.AddDocument(i, texts[i], DocumentStatus(i % 3), {i % 11});
+        const int id = generator() % i;
+        if (i % 3 == 0 && id != watched_id) {
+            is_removed[id] = true;
+            search_server.RemoveDocument(id);
+        }
+    }
+
+    SearchServer expected(dictionary[0]);
+    for (int i = 0; i < static_cast<int>(texts.size()); ++i) {
+        if (!is_removed[i]) {
+            expected.AddDocument(i, texts[i], DocumentStatus(i % 3), {i % 11});
+        }
+    }
+    ASSERT_EQUAL(Dump(search_server, queries), Dump(expected, queries));
+    ASSERT(watched_freqs == watched_copy);
+    for (const string& query : queries) {
+        ASSERT_EQUAL(ResultKey(search_server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 20)),
+                     ResultKey(expected.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 20)));
+    }
+
+    const string path = (filesystem::temp_directory_path() / "search_server_tests_reclaimed.bin"s).string();
+    search_server.SaveIndex(path);
+    ASSERT_EQUAL(Dump(SearchServer::LoadIndex(path), queries), Dump(expected, queries));
+    filesystem::remove(path);
+}
+
+// Файл с правильной контрольной суммой, но несогласованным содержимым не загружается
+void TestLoadIndexRejectsInconsistentFile() {
+    const string path = (filesystem::temp_directory_path() / "search_server_tests_invalid.bin"s).string();
+    // Два слова и два документа: "a b" и "b"
+    struct Contents {
+        vector<string_view> words = {"a"sv, "b"sv};
+        vector<uint64_t> term_offsets = {0, 2, 3};
+        vector<TermId> terms = {0, 1, 1};
+        uint64_t index_term_count = 2;
+        vector<DocumentOrdinal> posting_ordinals = {0, 0, 1};
+        double max_term_freq = 0.5;
+    };
+    const auto write = [&path](const Contents& contents) {
+        IndexFileWriter writer(path);
+        writer.WriteStrings({});
+        writer.WriteStrings(contents.words);
+        const vector<int> ids = {1, 2};
+        const vector<int> ratings = {0, 0};
+        const vector<DocumentStatus> statuses = {DocumentStatus::ACTUAL, DocumentStatus::ACTUAL};
+        const vector<DocumentOrdinal> live_ordinals = {0, 1};
+        writer.Write<uint64_t>(ids.size());
+        writer.WriteArray(ids.data(), ids.size());
+        writer.WriteArray(ratings.data(), ratings.size());
+        writer.WriteArray(statuses.data(), statuses.size());
+        writer.Write<uint64_t>(live_ordinals.size());
+        writer.WriteArray(live_ordinals.data(), live_ordinals.size());
+
+        const vector<double> freqs(contents.terms.size(), 0.5);
+        writer.WriteArray(contents.term_offsets.data(), contents.term_offsets.size());
+        writer.WriteArray(contents.terms.data(), contents.terms.size());
+        writer.WriteArray(freqs.data(), freqs.size());
+
+        vector<uint32_t> posting_offsets(contents.index_term_count + 1, 0);
+        posting_offsets[1] = 1;
+        for (size_t term = 2; term <= contents.index_term_count; ++term) {
+            posting_offsets[term] = static_cast<uint32_t>(contents.posting_ordinals.size());
+        }
+        const vector<double> term_freqs(contents.posting_ordinals.size(), 0.5);
+        const vector<double> max_term_freqs(contents.index_term_count, contents.max_term_freq);
+        writer.Write<uint64_t>(contents.index_term_count);
+        writer.Write<uint64_t>(contents.posting_ordinals.size());
+        writer.WriteArray(posting_offsets.data(), posting_offsets.size());
+        writer.WriteArray(contents.posting_ordinals.data(), contents.posting_ordinals.size());
+        writer.WriteArray(term_freqs.data(), term_freqs.size());
+        writer.WriteArray(max_term_freqs.data(), max_term_freqs.size());
+        writer.Finish();
+    };
+    const auto is_rejected = [&path]() {
+        try {
+            SearchServer::LoadIndex(path);
+        } catch (const invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+
+    write(Contents{});
+    ASSERT(!is_rejected());
+    ASSERT_EQUAL(get<0>(SearchServer::LoadIndex(path).MatchDocument("a b"sv, 1)).size(), 2u);
+
+    Contents decreasing_offsets;
+    decreasing_offsets.term_offsets = {0, 3, 2};
+    write(decreasing_offsets);
+    ASSERT(is_rejected());
+
+    Contents unknown_term;
+    unknown_term.terms = {0, 1, 2};
+    write(unknown_term);
+    ASSERT(is_rejected());
+
+    Contents unsorted_terms;
+    unsorted_terms.terms = {1, 0, 1};
+    write(unsorted_terms);
+    ASSERT(is_rejected());
+
+    Contents extra_index_term;
+    extra_index_term.index_term_count = 3;
+    write(extra_index_term);
+    ASSERT(is_rejected());
+
+    Contents unknown_ordinal;
+    unknown_ordinal.posting_ordinals = {0, 0, 2};
+    write(unknown_ordinal);
+    ASSERT(is_rejected());
+
+    // Максимум TF меньше TF постинга, отрицательный или не число
+    for (const double max_term_freq : {0.25, -1.0, numeric_limits<double>::quiet_NaN(), numeric_limits<double>::infinity()}) {
+        Contents invalid_max_term_freq;
+        invalid_max_term_freq.max_term_freq = max_term_freq;
+        write(invalid_max_term_freq);
+        ASSERT(is_rejected());
+    }
+
+    // Сумма длин стоп-слов переполняется и выглядит короткой
+    {
+        IndexFileWriter writer(path);
+        const vector<uint64_t> lengths = {numeric_limits<uint64_t>::max(), 2};
+        writer.Write<uint64_t>(lengths.size());
+        writer.WriteArray(lengths.data(), lengths.size());
+        writer.WriteArray("a", 1);
+        writer.Finish();
+    }
+    ASSERT(is_rejected());
+
+    filesystem::remove(path);
+}
+
+// После перезапуска журнал операций восстанавливает то же состояние, что у сервера без журнала
+void TestDurableReplayMatchesOriginal() {
+    mt19937 generator(19);
+    const auto dictionary = MakeDictionary(generator, 300);
+    const auto queries = MakeQueries(generator, dictionary, 30);
+    const string directory = (filesystem::temp_directory_path() / "search_server_tests_durable"s).string();
+    filesystem::remove_all(directory);
+
+    SearchServer reference(dictionary[0]);
+    int next_id = 0;
+    const auto apply_operations = [&](DurableSearchServer& durable, int operation_count) {
+        for (int i = 0; i < operation_count; ++i) {
+            const int kind = generator() % 10;
+            if (kind < 6) {
+                const string text = MakeText(generator, dictionary, 15);
+                const int id = next_id++;
+                const auto status = DocumentStatus(generator() % 4);
+                const vector<int> ratings = {int(generator() % 9) - 2, int(generator() % 5)};
+                durable.AddDocument(id, text, status, ratings);
+                reference.AddDocument(id, text, status, ratings);
+            } else if (kind < 8) {
+                const int id = generator() % (next_id + 1);
+                durable.RemoveDocument(id);
+                reference.RemoveDocument(id);
+            } else {
+                vector<string> texts;
+                const int document_count = generator() % 100;
+                for (int j = 0; j < document_count; ++j) {
+                    texts.push_back(MakeText(generator, dictionary, 15));
+                }
+                vector<DocumentInput> documents;
+                for (int j = 0; j < document_count; ++j) {
+                    const int id = generator() % 100 == 0 ? static_cast<int>(generator() % (next_id + 1)) : next_id++;
+                    documents.push_back({id, texts[j], DocumentStatus(generator() % 4), {int(generator() % 7)}});
+                }
+                string durable_error;
+                string reference_error;
+                try {
+                    durable.AddDocuments(documents);
+                } catch (const exception& e) {
+                    durable_error = e.what();
+                }
+                try {
+                    reference.AddDocuments(documents);
+                } catch (const exception& e) {
+                    reference_error = e.what();
+                }
+                ASSERT_EQUAL(durable_error, reference_error);
+            }
+        }
+    };
+
+    {
+        DurableSearchServer durable(directory, dictionary[0]);
+        apply_operations(durable, 500);
+    }
+    {
+        DurableSearchServer durable(directory, dictionary[0]);
+        ASSERT_EQUAL(Dump(durable.GetSearchServer(), queries), Dump(reference, queries));
+        apply_operations(durable, 300);
+        durable.Checkpoint();
+        apply_operations(durable, 300);
+    }
+    {
+        DurableSearchServer durable(directory, dictionary[0]);
+        ASSERT_EQUAL(Dump(durable.GetSearchServer(), queries), Dump(reference, queries));
+    }
+    filesystem::remove_all(directory);
+}
+
+// Записи, переданные в журнал, переживают аварийное завершение процесса без Sync
+void TestOperationLogSurvivesKill() {
+    const string path = (filesystem::temp_directory_path() / "search_server_tests_killed.log"s).string();
+    filesystem::remove(path);
+    const vector<DocumentInput> documents = {
+        {1, "white cat"sv, DocumentStatus::ACTUAL, {1, 2}},
+        {2, "black dog"sv, DocumentStatus::BANNED, {-3}},
+        {3, "white dog"sv, DocumentStatus::ACTUAL, {}},
+        {4, "grey cat and dog"sv, DocumentStatus::IRRELEVANT, {5}},
+    };
+
+    const pid_t child = fork();
+    ASSERT(child >= 0);
+    if (child == 0) {
+        OperationLog log(path);
+        log.LogAddDocuments(documents, documents.size());
+        log.LogRemoveDocument(3);
+        kill(getpid(), SIGKILL);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+
+    SearchServer expected(""s);
+    expected.AddDocuments(documents);
+    expected.RemoveDocument(3);
+    SearchServer recovered(""s);
+    ASSERT_EQUAL(OperationLog::Replay(path, recovered), documents.size() + 1);
+    const vector<string> queries = {"cat"s, "dog"s, "white -cat"s};
+    ASSERT_EQUAL(Dump(recovered, queries), Dump(expected, queries));
+    filesystem::remove(path);
+}
+
+// Версии, которые долго держат читатели, догоняются по журналу и не меняются, пока их читают
+void TestSnapshotVersionsCatchUp() {
+    mt19937 generator(29);
+    const auto dictionary = MakeDictionary(generator, 300);
+    const auto queries = MakeQueries(generator, dictionary, 20);
+
+    SnapshotSearchServer snapshot_server(dictionary[0]);
+    SearchServer expected(dictionary[0]);
+    vector<pair<SnapshotSearchServer::Snapshot, string>> held;
+    // Одна версия держится дольше, чем журнал позволяет догнать
+    SnapshotSearchServer::Snapshot long_held = snapshot_server.GetSnapshot();
+    const string long_held_dump = Dump(*long_held, queries);
+
+    for (int i = 0; i < static_cast<int>(SNAPSHOT_MAX_CATCH_UP) + 500; ++i) {
+        const string text = MakeText(generator, dictionary, 20);
+        snapshot_server.AddDocument(i, text, DocumentStatus::ACTUAL, {i % 7});
+        expected.AddDocument(i, text, DocumentStatus::ACTUAL, {i % 7});
+        if (i % 4 == 0) {
+            const int id = generator() % (i + 1);
+            snapshot_server.RemoveDocument(id);
+            expected.RemoveDocument(id);
+        }
+        if (i % 10 == 0) {
+            // Изменение с исключением повторяется на других версиях без последствий
+            ASSERT_THROWS(snapshot_server.AddDocument(-1, "x"s, DocumentStatus::ACTUAL, {}), invalid_argument);
+        }
+
+        if (generator() % 3 == 0) {
+            auto snapshot = snapshot_server.GetSnapshot();
+            string dump = i % 50 == 0 ? Dump(*snapshot, queries) : ""s;
+            held.emplace_back(move(snapshot), move(dump));
+        }
+        while (held.size() > 3 || (!held.empty() && generator() % 2 == 0)) {
+            const size_t pos = generator() % held.size();
+            if (!held[pos].second.empty()) {
+                ASSERT_EQUAL(Dump(*held[pos].first, queries), held[pos].second);
+            }
+            held.erase(held.begin() + pos);
+        }
+        if (i % 100 == 0) {
+            ASSERT_EQUAL(Dump(*snapshot_server.GetSnapshot(), queries), Dump(expected, queries));
+        }
+    }
+    ASSERT_EQUAL(Dump(*long_held, queries), long_held_dump);
+    long_held = {};
+    held.clear();
+    snapshot_server.AddDocument(100000, "x"s, DocumentStatus::ACTUAL, {});
+    expected.AddDocument(100000, "x"s, DocumentStatus::ACTUAL, {});
+    ASSERT_EQUAL(Dump(*snapshot_server.GetSnapshot(), queries), Dump(expected, queries));
+}
+
+// Сжатые постинги дают ту же выдачу, что и несжатые, в том числе после удалений,
+// новых добавлений и перестройки базового сегмента
+void TestCompressedPostingsMatchPlain() {
+    mt19937 generator(37);
+    const auto dictionary = MakeDictionary(generator, 400);
+    const auto queries = MakeQueries(generator, dictionary, 40);
+    SearchServer plain = MakeServer(generator, dictionary, 3000);
+    SearchServer compressed = plain;
+    compressed.SetPostingEncoding(PostingEncoding::COMPRESSED);
+
+    const auto assert_same = [&] {
+        ASSERT_EQUAL(Dump(compressed, queries), Dump(plain, queries));
+        for (const string& query : queries) {
+            ASSERT_EQUAL(ResultKey(compressed.FindTopDocuments(query, DocumentStatus::ACTUAL, 20, RetrievalMode::MAX_SCORE)),
+                         ResultKey(plain.FindTopDocuments(query, DocumentStatus::ACTUAL, 20, RetrievalMode::MAX_SCORE)));
+            ASSERT_EQUAL(ResultKey(compressed.FindTopDocuments(execution::par, query)),
+                         ResultKey(plain.FindTopDocuments(execution::par, query)));
+        }
+    };
+    assert_same();
+
+    int next_id = 3000;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 2500; ++i) {
+            if (generator() % 3 == 0) {
+                const int id = generator() % next_id;
+                plain.RemoveDocument(id);
+                compressed.RemoveDocument(id);
+            } else {
+                const string text = MakeText(generator, dictionary, 30);
+                const auto status = DocumentStatus(generator() % 3);
+                plain.AddDocument(next_id, text, status, {next_id % 9});
+                compressed.AddDocument(next_id, text, status, {next_id % 9});
+                ++next_id;
+            }
+        }
+        assert_same();
+    }
+    ASSERT(compressed.GetIndexMemoryUsage().posting_count == plain.GetIndexMemoryUsage().posting_count);
+}
+
+// Кэшированные IDF после любых изменений корпуса совпадают с посчитанными заново
+void TestInverseDocumentFreqCacheFollowsChanges() {
+    mt19937 generator(41);
+    const auto dictionary = MakeDictionary(generator, 200);
+    const auto queries = MakeQueries(generator, dictionary, 20);
+    SearchServer search_server(dictionary[0]);
+    map<int, string> texts;
+    int next_id = 0;
+    for (int step = 0; step < 40; ++step) {
+        const int kind = generator() % 3;
+        if (kind == 0) {
+            texts[next_id] = MakeText(generator, dictionary, 20);
+            search_server.AddDocument(next_id, texts[next_id], DocumentStatus::ACTUAL, {1});
+            ++next_id;
+        } else if (kind == 1 && !texts.empty()) {
+            const int id = next(texts.begin(), generator() % texts.size())->first;
+            texts.erase(id);
+            search_server.RemoveDocument(id);
+        } else {
+            vector<DocumentInput> batch;
+            for (int i = 0; i < 50; ++i) {
+                texts[next_id] = MakeText(generator, dictionary, 20);
+                batch.push_back({next_id, texts[next_id], DocumentStatus::ACTUAL, {1}});
+                ++next_id;
+            }
+            search_server.AddDocuments(batch);
+        }
+
+        SearchServer expected(dictionary[0]);
+        for (const auto& [id, text] : texts) {
+            expected.AddDocument(id, text, DocumentStatus::ACTUAL, {1});
+        }
+        for (const string& query : queries) {
+            AssertSameRelevances(search_server.FindTopDocuments(query), expected.FindTopDocuments(query), query);
+            AssertSameRelevances(search_server.FindTopDocuments(execution::par, query), expected.FindTopDocuments(query), query);
+        }
+    }
+
+    // Первый поиск слова после изменения — промах, повторный — попадание
+    search_server.AddDocument(next_id, dictionary[1], DocumentStatus::ACTUAL, {1});
+    const auto before = search_server.GetInverseDocumentFreqCacheStats();
+    search_server.FindTopDocuments(dictionary[1]);
+    const auto after_miss = search_server.GetInverseDocumentFreqCacheStats();
+    ASSERT_EQUAL(after_miss.misses, before.misses + 1);
+    ASSERT_EQUAL(after_miss.hits, before.hits);
+    search_server.FindTopDocuments(dictionary[1]);
+    const auto after_hit = search_server.GetInverseDocumentFreqCacheStats();
+    ASSERT_EQUAL(after_hit.misses, after_miss.misses);
+    ASSERT_EQUAL(after_hit.hits, after_miss.hits + 1);
+
+    // Поиски из нескольких потоков учитываются все до одного
+    constexpr int thread_count = 4;
+    constexpr int search_count = 1000;
+    vector<thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&search_server, &dictionary] {
+            for (int j = 0; j < search_count; ++j) {
+                search_server.FindTopDocuments(dictionary[1]);
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    const auto after_threads = search_server.GetInverseDocumentFreqCacheStats();
+    ASSERT_EQUAL(after_threads.misses, after_hit.misses);
+    ASSERT_EQUAL(after_threads.hits, after_hit.hits + thread_count * search_count);
+}
+
+// ConcurrentMap со строковыми ключами ведёт себя как std::map при вставках, удалениях
+// и росте корзин, а параллельные увеличения из нескольких потоков не теряются
+void TestConcurrentMapMatchesMap() {
+    mt19937 generator(43);
+    const auto dictionary = MakeDictionary(generator, 3000);
+    ConcurrentMap<string, int> concurrent_map(7);
+    map<string, int> expected;
+    for (int i = 0; i < 20000; ++i) {
+        const string& key = dictionary[generator() % dictionary.size()];
+        if (generator() % 4 == 0) {
+            concurrent_map.Erase(key);
+            expected.erase(key);
+        } else {
+            concurrent_map[key].ref_to_value += i;
+            expected[key] += i;
+        }
+    }
+    ASSERT_EQUAL(concurrent_map.GetSize(), expected.size());
+    ASSERT(concurrent_map.BuildOrdinaryMap() == expected);
+    ASSERT(concurrent_map.BuildOrdinaryMap(execution::par) == expected);
+    int64_t sum = 0;
+    concurrent_map.ForEach(execution::seq, [&sum](const string&, int value) {
+        sum += value;
+    });
+    ASSERT_EQUAL(sum, accumulate(expected.begin(), expected.end(), int64_t{0}, [](int64_t total, const auto& entry) {
+        return total + entry.second;
+    }));
+
+    ConcurrentMap<string, int> counters(16);
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&counters, &dictionary] {
+            for (const string& word : dictionary) {
+                ++counters[word].ref_to_value;
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    map<string, int> expected_counters;
+    for (const string& word : dictionary) {
+        expected_counters[word] += 4;
+    }
+    ASSERT(counters.BuildOrdinaryMap(execution::par) == expected_counters);
+}
+
+// Кэш результатов отдаёт то же, что поиск без кэша, после любых изменений индекса,
+// а запросы, отличающиеся порядком и повторами слов, попадают в одну запись
+void TestQueryResultCacheInvalidation() {
+    mt19937 generator(47);
+    const auto dictionary = MakeDictionary(generator, 200);
+    const auto queries = MakeQueries(generator, dictionary, 30);
+    SearchServer uncached = MakeServer(generator, dictionary, 1000);
+    SearchServer cached = uncached;
+    cached.SetQueryResultCacheCapacity(1 << 20);
+
+    const auto assert_same = [&] {
+        for (const string& query : queries) {
+            for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                ASSERT_EQUAL(ResultKey(cached.FindTopDocuments(query, status)), ResultKey(uncached.FindTopDocuments(query, status)));
+                ASSERT_EQUAL(ResultKey(cached.FindTopDocuments(execution::par, query, status)),
+                             ResultKey(uncached.FindTopDocuments(execution::par, query, status)));
+            }
+        }
+    };
+    assert_same();
+    const uint64_t hits_before = cached.GetQueryResultCacheStats().hits;
+    assert_same();
+    ASSERT(cached.GetQueryResultCacheStats().hits > hits_before);
+
+    int next_id = 1000;
+    for (int step = 0; step < 12; ++step) {
+        if (step % 3 == 0) {
+            const string text = MakeText(generator, dictionary, 30);
+            cached.AddDocument(next_id, text, DocumentStatus::ACTUAL, {step});
+            uncached.AddDocument(next_id, text, DocumentStatus::ACTUAL, {step});
+            ++next_id;
+        } else if (step % 3 == 1) {
+            const int id = generator() % next_id;
+            cached.RemoveDocument(execution::par, id);
+            uncached.RemoveDocument(execution::par, id);
+        } else {
+            vector<string> texts;
+            vector<DocumentInput> batch;
+            for (int i = 0; i < 20; ++i) {
+                texts.push_back(MakeText(generator, dictionary, 30));
+            }
+            for (int i = 0; i < 20; ++i) {
+                batch.push_back({next_id++, texts[i], DocumentStatus::BANNED, {i}});
+            }
+            cached.AddDocuments(batch);
+            uncached.AddDocuments(batch);
+        }
+        assert_same();
+    }
+
+    const string words = dictionary[1] + " "s + dictionary[2];
+    const auto documents = cached.FindTopDocuments(words);
+    const uint64_t hits = cached.GetQueryResultCacheStats().hits;
+    ASSERT_EQUAL(ResultKey(cached.FindTopDocuments(dictionary[2] + " "s + words)), ResultKey(documents));
+    ASSERT_EQUAL(cached.GetQueryResultCacheStats().hits, hits + 1);
+}
+
+// Потоковая и склеенная обработка пакета дают те же результаты, что ProcessQueries,
+// в порядке запросов при любом размере части
+void TestProcessQueriesStreamingMatchesProcessQueries() {
+    mt19937 generator(53);
+    const auto dictionary = MakeDictionary(generator, 300);
+    const SearchServer search_server = MakeServer(generator, dictionary, 2000);
+    const auto queries = MakeQueries(generator, dictionary, 300);
+    const auto expected = ProcessQueries(search_server, queries);
+    ASSERT_EQUAL(expected.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); i += 37) {
+        ASSERT_EQUAL(ResultKey(expected[i]), ResultKey(search_server.FindTopDocuments(queries[i])));
+    }
+
+    vector<Document> expected_joined;
+    for (const auto& documents : expected) {
+        expected_joined.insert(expected_joined.end(), documents.begin(), documents.end());
+    }
+    ASSERT_EQUAL(ResultKey(ProcessQueriesJoined(search_server, queries)), ResultKey(expected_joined));
+
+    const vector<string_view> query_views(queries.begin(), queries.end());
+    for (const size_t chunk_size : {size_t{0}, size_t{1}, size_t{7}, size_t{300}, size_t{1000}}) {
+        size_t next_index = 0;
+        ProcessQueriesStreaming(search_server, query_views, [&](size_t index, vector<Document>&& documents) {
+            ASSERT_EQUAL(index, next_index);
+            ASSERT_EQUAL(ResultKey(documents), ResultKey(expected[index]));
+            ++next_index;
+        }, chunk_size);
+        ASSERT_EQUAL(next_index, queries.size());
+    }
+}
+
+// RequestQueue не теряет запросы из нескольких потоков и забывает их, когда окно проходит
+void TestRequestQueueSlidingWindow() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "black dog"sv, DocumentStatus::ACTUAL, {2});
+
+    {
+        RequestQueue request_queue(search_server, chrono::hours(1), 60);
+        vector<thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&request_queue] {
+                for (int i = 0; i < 1000; ++i) {
+                    request_queue.AddFindRequest(i % 4 == 0 ? "parrot"sv : "cat"sv);
+                }
+            });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+        ASSERT_EQUAL(request_queue.GetRequestCount(), 4000);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1000);
+    }
+
+    RequestQueue request_queue(search_server, chrono::milliseconds(200), 4);
+    for (int i = 0; i < 5; ++i) {
+        request_queue.AddFindRequest("parrot"sv);
+        request_queue.AddFindRequest("dog"sv);
+    }
+    ASSERT_EQUAL(request_queue.GetRequestCount(), 10);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 5);
+    this_thread::sleep_for(chrono::milliseconds(300));
+    ASSERT_EQUAL(request_queue.GetRequestCount(), 0);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 0);
+    request_queue.AddFindRequest("parrot"sv);
+    ASSERT_EQUAL(request_queue.GetRequestCount(), 1);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+}
+
+// Статистика RequestQueue учитывает каждый запрос с его задержкой и размером выдачи
+void TestRequestQueueStats() {
+    SearchServer search_server("and"s);
+    for (int i = 0; i < 50; ++i) {
+        search_server.AddDocument(i, i % 2 == 0 ? "white cat"sv : "black dog"sv, DocumentStatus::ACTUAL, {i});
+    }
+    RequestQueue request_queue(search_server, chrono::hours(1), 60, chrono::minutes(1), 6);
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&request_queue] {
+            for (int i = 0; i < 500; ++i) {
+                request_queue.AddFindRequest(i % 5 == 0 ? "parrot"sv : "cat"sv);
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    const RequestQueueStats stats = request_queue.GetStats();
+    ASSERT_EQUAL(stats.request_count, 2000u);
+    ASSERT_EQUAL(stats.latencies.count, 2000u);
+    ASSERT_EQUAL(stats.result_counts.count, 2000u);
+    // Каждый пятый запрос без результатов, остальные находят MAX_RESULT_DOCUMENT_COUNT документов
+    ASSERT_EQUAL(stats.result_counts.counts[Histogram::GetBucketIndex(0)], 400u);
+    ASSERT_EQUAL(stats.result_counts.counts[Histogram::GetBucketIndex(MAX_RESULT_DOCUMENT_COUNT)], 1600u);
+    ASSERT_EQUAL(stats.result_counts.sum, 1600u * MAX_RESULT_DOCUMENT_COUNT);
+    ASSERT_EQUAL(stats.result_counts.GetPercentile(10), 0u);
+    ASSERT_EQUAL(stats.result_counts.GetPercentile(50), static_cast<uint64_t>(MAX_RESULT_DOCUMENT_COUNT));
+    ASSERT(stats.latency_p50.count() > 0);
+    ASSERT(stats.latency_p50 <= stats.latency_p90 && stats.latency_p90 <= stats.latency_p99
+           && stats.latency_p99 <= stats.latency_p999);
+    ASSERT(stats.requests_per_second > 0);
+
+    // Слоты по 10 мс сменяются десятки раз, пока запросы идут из нескольких потоков.
+    // Запись теряется, только если поток вытеснили посреди смены буфера, поэтому допуск мал
+    RequestQueue rotating_queue(search_server, chrono::hours(1), 60, chrono::seconds(2), 200);
+    atomic<uint64_t> request_count = 0;
+    const auto finish = chrono::steady_clock::now() + chrono::milliseconds(150);
+    threads.clear();
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&rotating_queue, &request_count, finish] {
+            while (chrono::steady_clock::now() < finish) {
+                rotating_queue.AddFindRequest("cat"sv);
+                request_count.fetch_add(1, memory_order_relaxed);
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    const RequestQueueStats rotated = rotating_queue.GetStats();
+    ASSERT(rotated.request_count <= request_count.load());
+    ASSERT(rotated.request_count + 100 >= request_count.load());
+    ASSERT_EQUAL(rotated.result_counts.counts[Histogram::GetBucketIndex(MAX_RESULT_DOCUMENT_COUNT)], rotated.request_count);
+}
+
+// StopWordSet отвечает так же, как std::set, на словах разной длины, в том числе длиннее 63
+void TestStopWordSetMatchesSet() {
+    mt19937 generator(59);
+    const auto make_word = [&generator](size_t max_length) {
+        string word(uniform_int_distribution<size_t>(1, max_length)(generator), 'a');
+        for (char& c : word) {
+            c = static_cast<char>('a' + generator() % 6);
+        }
+        return word;
+    };
+    for (const size_t max_length : {8, 100}) {
+        for (const size_t word_count : {0, 1, 2, 10, 300, 3000}) {
+            set<string, less<>> words;
+            while (words.size() < word_count) {
+                words.insert(make_word(max_length));
+            }
+            const StopWordSet stop_words(words);
+            ASSERT_EQUAL(stop_words.size(), words.size());
+            ASSERT(equal(stop_words.begin(), stop_words.end(), words.begin(), words.end()));
+            for (const string& word : words) {
+                ASSERT(stop_words.Contains(word));
+            }
+            for (int i = 0; i < 20000; ++i) {
+                const string word = make_word(max_length);
+                ASSERT_EQUAL(stop_words.Contains(word), words.count(word) > 0);
+            }
+            ASSERT(!stop_words.Contains(""sv));
+        }
+    }
+
+    // Пустое стоп-слово получается из двойного пробела в строке стоп-слов
+    const StopWordSet with_empty(set<string, less<>>{""s, "a"s, "bb"s});
+    ASSERT(with_empty.Contains(""sv));
+    ASSERT(with_empty.Contains("a"sv));
+    ASSERT(!with_empty.Contains("b"sv));
+    SearchServer search_server("a  bb "s);
+    search_server.AddDocument(1, "a cat"sv, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.FindTopDocuments("a cat bb"sv).size(), 1u);
+}
+
+// Частые слова пропускаются в плюс-словах, но минус-слова по-прежнему исключают документы;
+// список автоматических стоп-слов следует за изменениями корпуса
+void TestAutoStopWords() {
+    SearchServer search_server(""s);
+    for (int i = 0; i < 20; ++i) {
+        string text = "the"s;
+        if (i % 2 == 0) {
+            text += " cat"s;
+        }
+        if (i < 3) {
+            text += " dog"s;
+        }
+        search_server.AddDocument(i, text, DocumentStatus::ACTUAL, {i});
+    }
+    const auto dog_documents = search_server.FindTopDocuments("dog"sv);
+    ASSERT(search_server.GetAutoStopWords().empty());
+
+    search_server.SetAutoStopWords(0.4, 10);
+    using AutoStopWords = vector<pair<string_view, size_t>>;
+    ASSERT(search_server.GetAutoStopWords() == (AutoStopWords{{"the"sv, 20}, {"cat"sv, 10}}));
+    ASSERT(search_server.FindTopDocuments("the cat"sv).empty());
+    // IDF оставшихся слов не меняется
+    ASSERT_EQUAL(ResultKey(search_server.FindTopDocuments("the cat dog"sv)), ResultKey(dog_documents));
+    ASSERT_EQUAL(ResultKey(search_server.FindTopDocuments(execution::par, "the dog"sv)), ResultKey(dog_documents));
+    const auto without_cat = search_server.FindTopDocuments("dog -cat"sv);
+    ASSERT_EQUAL(without_cat.size(), 1u);
+    ASSERT_EQUAL(without_cat[0].id, 1);
+    ASSERT(search_server.FindTopDocuments("dog -the"sv).empty());
+    const auto [words, status] = search_server.MatchDocument("the cat dog"sv, 0);
+    ASSERT(words == vector<string_view>{"dog"sv});
+    ASSERT(get<0>(search_server.MatchDocument("dog -cat"sv, 0)).empty());
+
+    // Корпус меньше min_document_count: слова снова ищутся
+    search_server.SetAutoStopWords(0.4, 100);
+    ASSERT(search_server.GetAutoStopWords().empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"sv).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    // Доля слова упала после удалений: слово возвращается в поиск
+    search_server.SetAutoStopWords(0.4, 10);
+    for (int id = 4; id < 20; id += 4) {
+        search_server.RemoveDocument(id);
+    }
+    ASSERT(search_server.GetAutoStopWords() == (AutoStopWords{{"the"sv, 16}}));
+    ASSERT(!search_server.FindTopDocuments("cat"sv).empty());
+
+    search_server.SetAutoStopWords(1.0);
+    ASSERT(search_server.GetAutoStopWords().empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("the"sv).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+}
+
+// Свободный поток пула доделывает подзадачи, поставленные другим потоком, раньше новой задачи извне
+void TestThreadPoolStealsBeforeInjected() {
+    constexpr int subtask_count = 4;
+    atomic<bool> subtasks_submitted = false;
+    atomic<bool> injected_submitted = false;
+    atomic<int> started_subtasks = 0;
+    atomic<int> finished_subtasks = 0;
+    atomic<int> started_subtasks_before_injected = -1;
+    {
+        ThreadPool pool(2);
+        pool.Submit([&] {
+            for (int i = 0; i < subtask_count; ++i) {
+                pool.Submit([&] {
+                    started_subtasks.fetch_add(1);
+                    // Подзадачи не завершаются, пока внешняя задача не встала в очередь
+                    while (!injected_submitted.load()) {
+                        this_thread::yield();
+                    }
+                    finished_subtasks.fetch_add(1);
+                });
+            }
+            subtasks_submitted = true;
+            // Поток занят, пока подзадачи не выполнит другой поток
+            while (finished_subtasks.load() < subtask_count) {
+                this_thread::yield();
+            }
+        });
+        while (!subtasks_submitted.load()) {
+            this_thread::yield();
+        }
+        pool.Submit([&] {
+            started_subtasks_before_injected = started_subtasks.load();
+        });
+        injected_submitted = true;
+    }
+    ASSERT_EQUAL(finished_subtasks.load(), subtask_count);
+    ASSERT_EQUAL(started_subtasks_before_injected.load(), subtask_count);
+}
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestWordTokenizer);
+    RUN_TEST(tr, TestMaxScoreMatchesExhaustive);
+    RUN_TEST(tr, TestParallelFindMatchesSequential);
+    RUN_TEST(tr, TestNestedParallelFindMatchesSequential);
+    RUN_TEST(tr, TestAddDocumentsMatchesAddDocument);
+    RUN_TEST(tr, TestShardedMatchesUnsharded);
+    RUN_TEST(tr, TestShardedAddDocumentsStopsAtInvalid);
+    RUN_TEST(tr, TestFindTopDocumentsBatchMatchesSingleQueries);
+    RUN_TEST(tr, TestSaveIndexRoundTrip);
+    RUN_TEST(tr, TestLoadIndexRejectsInconsistentFile);
+    RUN_TEST(tr, TestRemovedOrdinalsAreReclaimed);
+    RUN_TEST(tr, TestDurableReplayMatchesOriginal);
+    RUN_TEST(tr, TestOperationLogSurvivesKill);
+    RUN_TEST(tr, TestSnapshotVersionsCatchUp);
+    RUN_TEST(tr, TestCompressedPostingsMatchPlain);
+    RUN_TEST(tr, TestInverseDocumentFreqCacheFollowsChanges);
+    RUN_TEST(tr, TestConcurrentMapMatchesMap);
+    RUN_TEST(tr, TestQueryResultCacheInvalidation);
+    RUN_TEST(tr, TestProcessQueriesStreamingMatchesProcessQueries);
+    RUN_TEST(tr, TestRequestQueueSlidingWindow);
+    RUN_TEST(tr, TestRequestQueueStats);
+    RUN_TEST(tr, TestStopWordSetMatchesSet);
+    RUN_TEST(tr, TestAutoStopWords);
+    RUN_TEST(tr, TestThreadPoolStealsBeforeInjected);
+}
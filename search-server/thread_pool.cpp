@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+// Пул и номер потока, выполняющего код, если это поток пула
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : queues_(std::max<size_t>(thread_count, 1)) {
+    threads_.reserve(queues_.size());
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        threads_.emplace_back([this, i] {
+            Run(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    wake_up_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    TaskQueue& queue = current_pool == this ? queues_[current_worker] : injected_;
+    // Счётчик растёт до постановки, чтобы взявший задачу поток не увёл его ниже нуля
+    pending_count_.fetch_add(1);
+    {
+        std::lock_guard guard(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    // Поток, решивший уснуть, проверяет pending_count_ под sleep_mutex_, поэтому сигнал не теряется
+    {
+        std::lock_guard guard(sleep_mutex_);
+    }
+    wake_up_.notify_one();
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return queues_.size();
+}
+
+void ThreadPool::Run(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    std::function<void()> task;
+    while (true) {
+        if (TryTake(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_up_.wait(lock, [this] {
+            return pending_count_.load() > 0 || is_stopping_;
+        });
+        if (is_stopping_ && pending_count_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryTake(size_t index, std::function<void()>& task) {
+    {
+        TaskQueue& own = queues_[index];
+        std::lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            pending_count_.fetch_sub(1);
+            return true;
+        }
+    }
+    // Сначала помогаем начатой работе других потоков и только потом берём новую
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        TaskQueue& victim = queues_[(index + offset) % queues_.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            pending_count_.fetch_sub(1);
+            return true;
+        }
+    }
+    {
+        std::lock_guard guard(injected_.mutex);
+        if (!injected_.tasks.empty()) {
+            task = std::move(injected_.tasks.front());
+            injected_.tasks.pop_front();
+            pending_count_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
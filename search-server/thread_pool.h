@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с перехватом задач. У каждого потока своя очередь: задачи, поставленные
+// из потока пула, попадают в его очередь и берутся с конца (последняя поставленная —
+// первой), а свободные потоки забирают задачи из начала чужих очередей.
+// Задачи извне попадают в общую очередь и выполняются в порядке поступления, но только
+// когда пусты и своя очередь, и очереди остальных потоков: свободный поток сначала
+// помогает завершить начатую работу и лишь потом берёт новую.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    // Дожидается выполнения всех поставленных задач
+    ~ThreadPool();
+
+    void Submit(std::function<void()> task);
+
+    size_t GetThreadCount() const;
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<TaskQueue> queues_;
+    TaskQueue injected_;
+    std::vector<std::thread> threads_;
+
+    // Задачи в очередях, ещё не взятые на выполнение
+    std::atomic<size_t> pending_count_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    bool is_stopping_ = false;
+
+    void Run(size_t index);
+    bool TryTake(size_t index, std::function<void()>& task);
+};
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+#include "top_documents.h"
+
+using namespace std;
+
+namespace {
+
+// Меньше этого числа документов на поток параллельный отбор не окупается
+constexpr size_t MIN_DOCUMENTS_PER_TOP_CHUNK = 4096;
+
+std::vector<Document> CollectTopHeap(std::vector<Document>::const_iterator first,
+                                     std::vector<Document>::const_iterator last,
+                                     size_t top_k) {
+    std::vector<Document> heap;
+    heap.reserve(top_k);
+    for (auto it = first; it != last; ++it) {
+        PushTopDocument(heap, *it, top_k);
+    }
+    return heap;
+}
+
+} // namespace
+
+bool PushTopDocument(std::vector<Document>& heap, const Document& document, size_t top_k) {
+    if (heap.size() < top_k) {
+        heap.push_back(document);
+        std::push_heap(heap.begin(), heap.end(), IsMoreRelevant);
+        return true;
+    }
+    if (top_k == 0 || !IsMoreRelevant(document, heap.front())) {
+        return false;
+    }
+    std::pop_heap(heap.begin(), heap.end(), IsMoreRelevant);
+    heap.back() = document;
+    std::push_heap(heap.begin(), heap.end(), IsMoreRelevant);
+    return true;
+}
+
+void SelectTopDocuments(std::vector<Document>& documents, size_t top_k) {
+    if (documents.size() > top_k) {
+        std::nth_element(documents.begin(), documents.begin() + top_k, documents.end(), IsMoreRelevant);
+        documents.resize(top_k);
+        // Иначе выдача держит память под всех кандидатов, пока жив результат
+        documents.shrink_to_fit();
+    }
+    std::sort(documents.begin(), documents.end(), IsMoreRelevant);
+}
+
+void SelectTopDocuments(const std::execution::sequenced_policy&, std::vector<Document>& documents, size_t top_k) {
+    SelectTopDocuments(documents, top_k);
+}
+
+void SelectTopDocuments(const std::execution::parallel_policy& policy, std::vector<Document>& documents, size_t top_k) {
+    const size_t chunk_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                                documents.size() / std::max(MIN_DOCUMENTS_PER_TOP_CHUNK, top_k));
+    if (chunk_count <= 1 || top_k == 0) {
+        SelectTopDocuments(documents, top_k);
+        return;
+    }
+
+    std::vector<size_t> chunk_indexes(chunk_count);
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+    std::vector<std::vector<Document>> heaps(chunk_count);
+    const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+    std::for_each(policy, chunk_indexes.begin(), chunk_indexes.end(),
+                  [&](size_t index) {
+                      const auto first = documents.cbegin() + std::min(documents.size(), index * chunk_size);
+                      const auto last = documents.cbegin() + std::min(documents.size(), (index + 1) * chunk_size);
+                      heaps[index] = CollectTopHeap(first, last, top_k);
+                  });
+
+    std::vector<Document> candidates;
+    candidates.reserve(chunk_count * top_k);
+    for (const auto& heap : heaps) {
+        candidates.insert(candidates.end(), heap.begin(), heap.end());
+    }
+    SelectTopDocuments(candidates, top_k);
+    documents = std::move(candidates);
+}
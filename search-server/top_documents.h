@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cmath>
+#include <execution>
+#include <vector>
+
+#include "document.h"
+
+constexpr double RELEVANCE_EQUALITY_TRESHOLD = 1e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной релевантности — по убыванию рейтинга
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EQUALITY_TRESHOLD) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Добавляет документ в кучу из не более чем top_k лучших документов, на вершине кучи — худший.
+// Возвращает false, если документ не попал в кучу.
+bool PushTopDocument(std::vector<Document>& heap, const Document& document, size_t top_k);
+
+// Оставляет в documents не более top_k лучших документов, упорядоченных по IsMoreRelevant.
+// Вместо полной сортировки используется nth_element, а параллельная версия
+// собирает кучи лучших документов по частям и затем объединяет их.
+void SelectTopDocuments(std::vector<Document>& documents, size_t top_k);
+void SelectTopDocuments(const std::execution::sequenced_policy& policy, std::vector<Document>& documents, size_t top_k);
+void SelectTopDocuments(const std::execution::parallel_policy& policy, std::vector<Document>& documents, size_t top_k);